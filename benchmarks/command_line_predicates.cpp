@@ -0,0 +1,100 @@
+// Cost of a burst of process creations when groups filter on command lines: name lookup in the
+// Process_Index, then evaluation of the predicates of the matching groups (only for tracked processes).
+//
+// Build: cl /std:c++latest /O2 /EHsc benchmarks\command_line_predicates.cpp sources\process_index.cpp
+//        g++ -std=c++20 -O2 benchmarks/command_line_predicates.cpp sources/process_index.cpp
+
+#include "../sources/process_index.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct Group
+{
+	std::unordered_set<std::wstring>	proccess_names;
+	std::vector<std::wstring>			command_line_predicates;
+};
+
+constexpr size_t nb_spawns_per_burst = 10'000;
+constexpr size_t nb_bursts = 100;
+
+struct Spawn
+{
+	std::wstring name;
+	std::wstring command_line;
+};
+
+static std::vector<Spawn> generate_burst()
+{
+	std::vector<Spawn> spawns;
+
+	spawns.reserve(nb_spawns_per_burst);
+	for (size_t i = 0; i < nb_spawns_per_burst; i++)
+	{
+		Spawn spawn;
+
+		if (i % 4 == 0) // Untracked noise
+		{
+			spawn.name = L"conhost.exe";
+			spawn.command_line = L"\\??\\C:\\WINDOWS\\system32\\conhost.exe 0xffffffff -ForceV1";
+		}
+		else
+		{
+			spawn.name = L"cl.exe";
+			spawn.command_line = L"\"C:\\Program Files\\Microsoft Visual Studio\\2022\\VC\\bin\\cl.exe\" /c /Zi /nologo /W3 /WX- /diagnostics:column "
+				L"/O2 /Oi /GL /D NDEBUG /D _CONSOLE /Gm- /EHsc /MD /GS /Gy /fp:precise /permissive- /Zc:wchar_t /Zc:forScope "
+				L"/Zc:inline /std:c++latest /Fo\"x64\\Release\\\\\" /Fd\"x64\\Release\\vc143.pdb\" /external:W3 /Gd /TP /FC "
+				L"C:\\work\\project\\sources\\module_" + std::to_wstring(i) + L".cpp";
+		}
+		spawns.push_back(std::move(spawn));
+	}
+	return spawns;
+}
+
+int main()
+{
+	std::vector<Group> groups(4);
+
+	groups[0].proccess_names = { L"cl.exe" }; // No predicates
+	groups[1].proccess_names = { L"cl.exe" };
+	groups[1].command_line_predicates = { L"/d ndebug", L"/o2" };
+	groups[2].proccess_names = { L"cl*" };
+	groups[2].command_line_predicates = { L"*module_9*.cpp" };
+	groups[3].proccess_names = { L"cl.exe" };
+	groups[3].command_line_predicates = { L"/analyze", L"/fsanitize=address", L"--rebuild" }; // Never matches
+
+	Process_Index index;
+	index.clear();
+	for (Group& group : groups)
+		index.set_group_processes(&group, group.proccess_names);
+
+	std::vector<Spawn>	spawns = generate_burst();
+	size_t				nb_recorded = 0;
+	auto				start = std::chrono::steady_clock::now();
+
+	for (size_t burst = 0; burst < nb_bursts; burst++)
+	{
+		for (const Spawn& spawn : spawns)
+		{
+			const Group_List* tracking_groups = index.find(spawn.name);
+
+			if (!tracking_groups)
+				continue;
+			for (Group* group : *tracking_groups)
+			{
+				if (match_command_line_predicates(group->command_line_predicates, spawn.command_line))
+					nb_recorded++;
+			}
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double total_ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+	printf("%zu bursts of %zu spawns, %zu recorded executions\n", nb_bursts, nb_spawns_per_burst, nb_recorded);
+	printf("%8.1f ns/spawn, %8.3f ms/burst\n", total_ns / (nb_bursts * nb_spawns_per_burst), total_ns / nb_bursts / 1'000'000.0);
+	return 0;
+}
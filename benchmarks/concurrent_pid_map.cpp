@@ -0,0 +1,146 @@
+// Contention stress test of the pid map used by the capture threads: every thread inserts its own pids
+// (multiples of 4 like on Windows) while an other thread takes them, as the WMI thread and the thread pool
+// callbacks do. Compared with an unordered_map behind a single mutex, checked with a checksum of the
+// taken values.
+//
+// Usage: concurrent_pid_map [nb_threads...] (default: 1 4 16)
+//
+// Build: cl /std:c++latest /O2 /EHsc benchmarks\concurrent_pid_map.cpp
+//        g++ -std=c++20 -O2 -pthread benchmarks/concurrent_pid_map.cpp
+
+#include "../sources/concurrent_pid_map.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t nb_pids_per_thread = 20'000;
+constexpr uint32_t nb_rounds = 10;
+
+struct Locked_Map
+{
+	std::mutex							mutex;
+	std::unordered_map<uint32_t, uint64_t>	map;
+
+	void insert(uint32_t pid, uint64_t value)
+	{
+		std::lock_guard lock(mutex);
+		map[pid] = value;
+	}
+
+	bool take(uint32_t pid, uint64_t& value)
+	{
+		std::lock_guard lock(mutex);
+		auto it = map.find(pid);
+		if (it == map.end())
+			return false;
+		value = it->second;
+		map.erase(it);
+		return true;
+	}
+};
+
+// Nanoseconds per operation (an insert or a take), false if an entry was lost
+template<typename Map>
+static bool measure_ns_per_operation(uint32_t nb_threads, double& ns_per_operation)
+{
+	uint64_t	nb_operations = 0;
+	double		total_ns = 0.0;
+
+	for (uint32_t round = 0; round < nb_rounds; round++)
+	{
+		Map							map;
+		std::atomic<uint64_t>		nb_taken = 0;
+		std::atomic<uint64_t>		taken_checksum = 0;
+		std::atomic<uint32_t>		nb_ready = 0;
+		std::vector<std::thread>	threads;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (uint32_t thread_index = 0; thread_index < nb_threads; thread_index++)
+		{
+			threads.emplace_back([&, thread_index]() {
+				uint32_t victim_index = (thread_index + 1) % nb_threads;
+
+				// Start together to measure the contention
+				nb_ready++;
+				while (nb_ready.load() < nb_threads)
+					std::this_thread::yield();
+
+				for (uint32_t i = 0; i < nb_pids_per_thread; i++)
+				{
+					uint32_t pid = (i * nb_threads + thread_index) * 4;
+					map.insert(pid, (uint64_t)pid + 1);
+
+					// Take an entry inserted by an other thread, it may not be there yet
+					uint32_t	victim_pid = (i * nb_threads + victim_index) * 4;
+					uint64_t	value;
+					if (map.take(victim_pid, value))
+					{
+						nb_taken++;
+						taken_checksum += value;
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		auto end = std::chrono::steady_clock::now();
+
+		// Take what remains
+		for (uint32_t pid_index = 0; pid_index < nb_threads * nb_pids_per_thread; pid_index++)
+		{
+			uint64_t value;
+			if (map.take(pid_index * 4, value))
+			{
+				nb_taken++;
+				taken_checksum += value;
+			}
+		}
+
+		uint64_t expected_checksum = 0;
+		for (uint64_t pid_index = 0; pid_index < nb_threads * nb_pids_per_thread; pid_index++)
+			expected_checksum += pid_index * 4 + 1;
+		if (nb_taken != (uint64_t)nb_threads * nb_pids_per_thread || taken_checksum != expected_checksum)
+			return false;
+
+		nb_operations += 2ull * nb_threads * nb_pids_per_thread;
+		total_ns += std::chrono::duration<double, std::nano>(end - start).count();
+	}
+	ns_per_operation = total_ns / nb_operations;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<uint32_t> nb_threads = { 1, 4, 16 };
+
+	if (argc > 1)
+	{
+		nb_threads.clear();
+		for (int i = 1; i < argc; i++)
+			nb_threads.push_back((uint32_t)std::strtoul(argv[i], nullptr, 10));
+	}
+
+	printf("%-10s %22s %22s\n", "threads", "Concurrent_Pid_Map", "mutex + unordered_map");
+	for (uint32_t count : nb_threads)
+	{
+		double map_ns;
+		double locked_ns;
+
+		if (count == 0 || !measure_ns_per_operation<Concurrent_Pid_Map<uint64_t>>(count, map_ns)
+			|| !measure_ns_per_operation<Locked_Map>(count, locked_ns))
+		{
+			printf("Entries lost with %u threads\n", count);
+			return 1;
+		}
+		printf("%-10u %16.1f ns/op %16.1f ns/op\n", count, map_ns, locked_ns);
+	}
+	return 0;
+}
@@ -0,0 +1,430 @@
+// Cost of a frame of the UI without GPU nor window: ImGui and ImPlot run without renderer backend and
+// ui_frame draws a synthesized group while scripted zooms and pans move the graph. For each frame:
+//  - ui_frame: widgets, stats panel and ImPlot draw lists
+//  - Render: end of the ImGui frame (draw data), what Present would consume
+//  - heap allocations of the render thread (operator new and ImGui allocator)
+// and for each frame published by the view thread: merge of pending executions, generate_view_data and
+// the latency from the request of the range to the publication.
+// Then the background mode is measured as the application does it without its D3D11 part: resident memory
+// before and after the release of the contexts and of the buffers of the view thread, and the time to draw
+// the range again once they are rebuilt.
+//
+// Usage: frame [nb_executions...] (default: 10000 1000000), 100000000 executions need about 13 GB
+//
+// Build (without _DEBUG, the allocations are counted here):
+//  cl /std:c++latest /O2 /EHsc /I third-party /I third-party\imgui benchmarks\frame.cpp sources\ui.cpp sources\view.cpp sources\intervals.cpp sources\group.cpp sources\trace.cpp sources\diagnostics.cpp sources\capture_lag.cpp
+//     sources\concurrency.cpp sources\concurrent_pid_map.cpp sources\process_index.cpp sources\frame_arena.cpp
+//     third-party\imgui\imgui*.cpp third-party\implot\implot*.cpp
+//  g++ -std=c++20 -O2 -pthread -I benchmarks/linux -I third-party -I third-party/imgui benchmarks/frame.cpp sources/ui.cpp
+//     sources/view.cpp sources/concurrency.cpp sources/concurrent_pid_map.cpp sources/process_index.cpp
+//     sources/intervals.cpp sources/group.cpp sources/trace.cpp sources/diagnostics.cpp sources/capture_lag.cpp sources/frame_arena.cpp third-party/imgui/imgui*.cpp third-party/implot/implot*.cpp
+//  On Linux benchmarks/linux/Windows.h stands for the few Win32 functions used by the UI and the view thread.
+
+#include "../sources/application.h"
+#include "../sources/ui.h"
+#include "../sources/view.h"
+#include "../sources/wmi.h"
+
+#include <imgui/imgui.h>
+#include <implot/implot.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#   include <psapi.h>
+#else
+#   include <malloc.h>
+#   include <unistd.h>
+#endif
+
+DearTime g_dear_time;
+
+// Stand-ins of application.cpp and wmi.cpp, the groups dialog is never opened
+Group* get_tracking_group(const std::string& name)
+{
+	auto it = g_dear_time.groups.find(name);
+	return it == g_dear_time.groups.end() ? nullptr : it->second;
+}
+
+Group* get_tracking_group_by_id(uint32_t id)
+{
+	for (const auto& group_pair : g_dear_time.groups)
+		if (group_pair.second->id == id)
+			return group_pair.second;
+	return nullptr;
+}
+
+void attach_running_processes(const Group*) {}
+Tracking_Pool_Stats get_tracking_pool_stats() { return {}; }
+std::string create_new_group() { return {}; }
+std::string delete_group(const std::string&) { return {}; }
+Rename_Errors rename_group(const std::string&, const std::string&) { return Rename_Errors::error_not_found; }
+void get_processes_string(const std::string&, char* buffer, size_t) { buffer[0] = '\0'; }
+Update_Processes_Errors udpate_processes(const std::string&, const std::string&, size_t) { return Update_Processes_Errors::group_not_found; }
+void get_command_line_predicates_string(const std::string&, char* buffer, size_t) { buffer[0] = '\0'; }
+Update_Processes_Errors update_command_line_predicates(const std::string&, const std::string&, size_t) { return Update_Processes_Errors::group_not_found; }
+void update_freeze_detection(const std::string&, uint32_t, uint32_t) {}
+void update_track_process_tree(const std::string&, bool) {}
+
+//==============================================================================
+
+static thread_local uint64_t nb_allocations = 0;
+
+void* operator new(size_t size)
+{
+	nb_allocations++;
+
+	void* pointer = malloc(size ? size : 1);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+static void* imgui_allocate(size_t size, void*)
+{
+	nb_allocations++;
+	return malloc(size);
+}
+
+static void imgui_free(void* pointer, void*)
+{
+	free(pointer);
+}
+
+//==============================================================================
+
+constexpr uint64_t	synthesized_duration = 365 * day_duration; // Executions are spread over a year
+constexpr double	display_width = 1920.0;
+constexpr double	display_height = 1080.0;
+constexpr auto		view_timeout = std::chrono::seconds(60);
+
+struct Samples
+{
+	std::vector<double> ui_frame_us;
+	std::vector<double> render_us;
+	std::vector<double> allocations;
+	std::vector<double> merge_us;
+	std::vector<double> generation_us;
+	std::vector<double> view_latency_us;
+};
+
+// Resident memory of the process (working set on Windows)
+static double get_resident_mb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.WorkingSetSize / (1024.0 * 1024.0);
+#else
+	long	size = 0;
+	long	resident = 0;
+	FILE*	statm = fopen("/proc/self/statm", "r");
+
+	if (statm)
+	{
+		if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+			resident = 0;
+		fclose(statm);
+	}
+	return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#endif
+}
+
+// Freed blocks cached by the heap are given back to the system, as the application does in background mode
+static void trim_heap()
+{
+#if defined(_WIN32)
+	HeapCompact(GetProcessHeap(), 0);
+	SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+#else
+	malloc_trim(0);
+#endif
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Deterministic pseudo random numbers, the same dataset is drawn on every run
+static uint64_t next_random(uint64_t& state)
+{
+	state = state * 6364136223846793005ull + 1442695040888963407ull;
+	return state >> 33;
+}
+
+static Group* create_synthesized_group(uint32_t id, uint64_t nb_executions, uint64_t start_date)
+{
+	Group*		group = new Group();
+	uint64_t	gap = std::max(synthesized_duration * WINDOWS_TICK / nb_executions, (uint64_t)2);
+	uint64_t	time = (start_date + SEC_TO_UNIX_EPOCH) * WINDOWS_TICK;
+	uint64_t	random = id;
+
+	group->name = "benchmark " + std::to_string(nb_executions);
+	group->id = id;
+	group->executables = { L"cl.exe", L"link.exe", L"clang++.exe", L"MSBuild.exe" };
+
+	// Pending, merged by the view thread as recorded executions are
+	group->executions.reserve(nb_executions);
+	group->executions_resources.reserve(nb_executions);
+	for (uint64_t i = 0; i < nb_executions; i++)
+	{
+		uint64_t			duration = 1 + next_random(random) % gap; // Some executions overlap the next one
+		Execution_Resources	resources = {};
+
+		time += gap / 2 + next_random(random) % gap;
+		resources.start_time = time;
+		resources.end_time = time + duration;
+		resources.user_time_ms = (uint32_t)(duration / 20'000);
+		resources.kernel_time_ms = (uint32_t)(duration / 100'000);
+		resources.read_bytes = next_random(random) % (64 << 20);
+		resources.write_bytes = next_random(random) % (16 << 20);
+		resources.peak_memory_kb = (uint32_t)(next_random(random) % (1 << 20));
+		resources.executable_index = (uint32_t)(i % group->executables.size());
+		group->executions.push_back({ resources.start_time, resources.end_time });
+		group->executions_resources.push_back(resources);
+	}
+	group->executions_push_times.assign(nb_executions, get_current_windows_ticks());
+	return group;
+}
+
+static void run_frame(double range_start, double range_end, Samples& samples)
+{
+	uint64_t	frame_allocations = nb_allocations;
+	auto		start = std::chrono::steady_clock::now();
+
+	ImGui::NewFrame();
+	ImPlot::SetNextAxisLimits(ImAxis_X1, range_start, range_end, ImPlotCond_Always);
+	ui_frame();
+
+	auto ui_frame_end = std::chrono::steady_clock::now();
+
+	ImGui::Render();
+
+	auto end = std::chrono::steady_clock::now();
+
+	frame_allocations = nb_allocations - frame_allocations; // Before pushing samples
+	samples.ui_frame_us.push_back(elapsed_us(start, ui_frame_end));
+	samples.render_us.push_back(elapsed_us(ui_frame_end, end));
+	samples.allocations.push_back((double)frame_allocations);
+}
+
+// Wait for the frame of the range, as the main loop would be woken up by request_redraw
+static bool wait_for_view(uint32_t group_id, double range_start, double range_end, std::chrono::steady_clock::time_point request_time, Samples& samples)
+{
+	for (;;)
+	{
+		const View_Frame& frame = get_view_frame();
+
+		if (frame.group_id == group_id && frame.range_start == range_start && frame.range_end == range_end)
+		{
+			samples.view_latency_us.push_back(elapsed_us(request_time, std::chrono::steady_clock::now()));
+			samples.merge_us.push_back(frame.merge_duration_ns / 1000.0);
+			samples.generation_us.push_back(frame.generation_duration_ns / 1000.0);
+			return true;
+		}
+		if (std::chrono::steady_clock::now() - request_time > view_timeout)
+			return false;
+		std::this_thread::yield();
+	}
+}
+
+// A frame requests the range and draws the previous data, the next one draws the data of the range
+static bool run_step(uint32_t group_id, double range_start, double range_end, Samples& samples)
+{
+	run_frame(range_start, range_end, samples);
+	if (!wait_for_view(group_id, range_start, range_end, std::chrono::steady_clock::now(), samples))
+		return false;
+	run_frame(range_start, range_end, samples);
+	return true;
+}
+
+// No renderer backend, the font atlas is built on the CPU only
+static void create_ui_contexts()
+{
+	ImGui::CreateContext();
+	ImPlot::CreateContext();
+
+	ImGuiIO& io = ImGui::GetIO();
+	unsigned char*	pixels;
+	int				atlas_width;
+	int				atlas_height;
+
+	io.IniFilename = nullptr;
+	io.DisplaySize = ImVec2((float)display_width, (float)display_height);
+	io.DeltaTime = 1.0f / 60.0f;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &atlas_width, &atlas_height);
+
+	initialize_ui();
+}
+
+static void destroy_ui_contexts()
+{
+	terminate_ui();
+	ImPlot::DestroyContext();
+	ImGui::DestroyContext();
+}
+
+// Memory kept by the render subsystem of the group (contexts, frame arena, frames and cache of the view
+// thread) and time to draw the range again once restored
+static bool run_background_mode(uint32_t group_id, double range_start, double range_end)
+{
+	trim_heap(); // Only what the background mode releases is measured
+
+	double	foreground_mb = get_resident_mb();
+	auto	start = std::chrono::steady_clock::now();
+
+	destroy_ui_contexts();
+	suspend_view();
+	trim_heap();
+
+	auto	released = std::chrono::steady_clock::now();
+	double	background_mb = get_resident_mb();
+	Samples	samples;
+
+	create_ui_contexts();
+	resume_view();
+	if (!run_step(group_id, range_start, range_end, samples))
+		return false;
+
+	auto restored = std::chrono::steady_clock::now();
+
+	printf("Background mode: resident %.1f MB -> %.1f MB, released in %.1f ms, drawn again in %.1f ms\n",
+		foreground_mb, background_mb, elapsed_us(start, released) / 1000.0, elapsed_us(released, restored) / 1000.0);
+	return true;
+}
+
+static void print_percentiles(const char* name, std::vector<double>& values)
+{
+	if (values.empty())
+		return;
+
+	std::sort(values.begin(), values.end());
+
+	auto percentile = [&](double ratio) { return values[std::min((size_t)(ratio * values.size()), values.size() - 1)]; };
+	printf("%-26s %12.1f %12.1f %12.1f %12.1f\n", name, percentile(0.5), percentile(0.9), percentile(0.99), values.back());
+}
+
+static bool run_benchmark(uint32_t group_id, uint64_t nb_executions)
+{
+	uint64_t	start_date = (uint64_t)time(0) - synthesized_duration;
+	Group*		group = create_synthesized_group(group_id, nb_executions, start_date);
+	Samples		samples;
+
+	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	g_dear_time.groups[group->name] = group;
+	g_dear_time.current_group_name = group->name;
+	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+
+	// The view thread is woken up by the first request, its frame includes the merge of all executions
+	double full_start = (double)start_date - day_duration;
+	double full_end = (double)(start_date + synthesized_duration) + 2 * day_duration;
+
+	if (!run_step(group_id, full_start, full_end, samples))
+		return false;
+
+	double initial_merge_ms = samples.merge_us.front() / 1000.0;
+	samples.merge_us.clear();
+
+	// Zoom in down to about a minute around the middle, pan a day wide range, then zoom out
+	double center = (full_start + full_end) / 2.0;
+	double width = full_end - full_start;
+
+	for (; width > 60.0; width /= 2.0)
+		if (!run_step(group_id, center - width / 2.0, center + width / 2.0, samples))
+			return false;
+
+	width = (double)day_duration;
+	for (int direction : { 1, -1 })
+	{
+		for (int i = 0; i < 100; i++)
+		{
+			center += direction * width / 10.0;
+			if (!run_step(group_id, center - width / 2.0, center + width / 2.0, samples))
+				return false;
+		}
+	}
+
+	for (; width < full_end - full_start; width *= 2.0)
+		if (!run_step(group_id, center - width / 2.0, center + width / 2.0, samples))
+			return false;
+
+	printf("%llu executions, initial merge %.1f ms, %zu frames\n", (unsigned long long)nb_executions, initial_merge_ms, samples.ui_frame_us.size());
+	printf("%-26s %12s %12s %12s %12s\n", "", "p50", "p90", "p99", "max");
+	print_percentiles("ui_frame (us)", samples.ui_frame_us);
+	print_percentiles("Render (us)", samples.render_us);
+	print_percentiles("Allocations per frame", samples.allocations);
+	print_percentiles("View merge (us)", samples.merge_us);
+	print_percentiles("generate_view_data (us)", samples.generation_us);
+	print_percentiles("View latency (us)", samples.view_latency_us);
+
+	if (!run_background_mode(group_id, center - width / 2.0, center + width / 2.0))
+		return false;
+	printf("\n");
+
+	// Freed by the view thread, as a deleted group
+	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	g_dear_time.groups.erase(group->name);
+	g_dear_time.retired_groups.push_back(group);
+	g_dear_time.current_group_name.clear();
+	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+	request_view_update();
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<uint64_t> nb_executions = { 10'000, 1'000'000 };
+
+	if (argc > 1)
+	{
+		nb_executions.clear();
+		for (int i = 1; i < argc; i++)
+			nb_executions.push_back(std::strtoull(argv[i], nullptr, 10));
+	}
+
+	static volatile LONG nb_requested_redraws = 0;
+
+	InitializeCriticalSection(&g_dear_time.editing_groups_critical_section);
+	g_dear_time.nb_requested_redraws = &nb_requested_redraws;
+	g_dear_time.redraw_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	g_dear_time.empty_group = new Group();
+	g_dear_time.empty_group->id = 0xffffffff;
+
+	ImGui::SetAllocatorFunctions(imgui_allocate, imgui_free);
+	create_ui_contexts();
+	initialize_view_thread();
+
+	// The first frame of the plot applies its default limits, scripted ones are taken from the next one
+	Samples warm_up;
+	run_frame(0.0, 1.0, warm_up);
+
+	int result = 0;
+	for (size_t i = 0; i < nb_executions.size() && result == 0; i++)
+	{
+		if (nb_executions[i] == 0 || !run_benchmark((uint32_t)i, nb_executions[i]))
+		{
+			printf("No frame for %llu executions\n", (unsigned long long)nb_executions[i]);
+			result = 1;
+		}
+	}
+
+	terminate_view_thread();
+	destroy_ui_contexts();
+	return result;
+}
@@ -0,0 +1,205 @@
+// Kernels of the history of executions (sources/intervals.h) on histories of 1k to 100M executions:
+//  - insert_merge_entry: merge of recorded executions in their arrival order (ns per execution, bytes
+//    of the merged history per execution)
+//  - aggregate_periods: aggregation of the whole history in about 1000 bars (ns per execution, bytes
+//    read per execution)
+//  - get_optimal_period_duration: per visible range (ns per call)
+// Executions arrive as they are recorded, at their termination:
+//  - in_order: regular executions that don't overlap
+//  - out_of_order: mostly short executions, a long one arrives after the shorter ones started later
+//  - overlapping: executions every 10 seconds lasting minutes, the history collapses in few entries
+//  - bursty: bursts of 1000 executions in a fraction of second (parallel build), then an hour idle
+//
+// Usage: intervals [--csv] [maximum_nb_executions] (default: 10000000, 100000000 needs about 8 GB)
+// --csv prints "kernel,distribution,nb_executions,ns_per_execution,bytes_per_execution" lines, to compare
+// versions with a diff or a spreadsheet.
+//
+// Build: cl /std:c++latest /O2 /EHsc /DNDEBUG benchmarks\intervals.cpp sources\intervals.cpp
+//        g++ -std=c++20 -O2 -DNDEBUG benchmarks/intervals.cpp sources/intervals.cpp
+
+#include "../sources/intervals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+constexpr uint64_t	start_date = 1'700'000'000; // Unix seconds
+constexpr uint64_t	minimum_nb_measured_executions = 10'000'000; // Small histories are measured many times
+constexpr uint64_t	nb_aggregated_periods = 1000;
+constexpr uint64_t	nb_period_duration_calls = 10'000'000;
+
+enum class Distribution
+{
+	in_order,
+	out_of_order,
+	overlapping,
+	bursty,
+};
+
+constexpr const char* distribution_names[] = { "in_order", "out_of_order", "overlapping", "bursty" };
+
+static bool is_csv = false;
+
+// Deterministic pseudo random numbers, the same histories are measured on every run
+static uint64_t next_random(uint64_t& state)
+{
+	state = state * 6364136223846793005ull + 1442695040888963407ull;
+	return state >> 33;
+}
+
+// Executions in their arrival order (by end time, as they are recorded at termination)
+static std::vector<RunningEntry> generate_executions(Distribution distribution, uint64_t nb_executions)
+{
+	std::vector<RunningEntry>	executions(nb_executions);
+	uint64_t					time = UnixSecondsToWindowsTick(start_date);
+	uint64_t					random = (uint64_t)distribution + 1;
+
+	for (uint64_t i = 0; i < nb_executions; i++)
+	{
+		uint64_t duration = 0;
+
+		switch (distribution)
+		{
+		case Distribution::in_order:
+			time += 60 * WINDOWS_TICK;
+			duration = 30 * WINDOWS_TICK;
+			break;
+		case Distribution::out_of_order:
+			time += 60 * WINDOWS_TICK;
+			if (next_random(random) % 20) // Short ones, others last up to half an hour and arrive after many of them
+				duration = (1 + next_random(random) % 30) * WINDOWS_TICK;
+			else
+				duration = (5 * minute_duration + next_random(random) % (25 * minute_duration)) * WINDOWS_TICK;
+			break;
+		case Distribution::overlapping:
+			time += 10 * WINDOWS_TICK;
+			duration = (60 + next_random(random) % (10 * minute_duration)) * WINDOWS_TICK;
+			break;
+		case Distribution::bursty:
+			time += i % 1000 == 0 ? hour_duration * WINDOWS_TICK : 1000 + next_random(random) % 2000; // 100 to 300 us
+			duration = (1 + next_random(random) % 5) * WINDOWS_TICK;
+			break;
+		}
+		executions[i] = { time, time + duration };
+	}
+
+	if (distribution != Distribution::in_order)
+		std::stable_sort(executions.begin(), executions.end(),
+			[](const RunningEntry& a, const RunningEntry& b) { return a.end_time < b.end_time; });
+	return executions;
+}
+
+static void print_result(const char* kernel, const char* distribution, uint64_t nb_executions, double ns_per_execution, double bytes_per_execution)
+{
+	if (is_csv)
+		printf("%s,%s,%llu,%.3f,%.3f\n", kernel, distribution, (unsigned long long)nb_executions, ns_per_execution, bytes_per_execution);
+	else
+		printf("%-28s %-14s %12llu %14.2f %14.2f\n", kernel, distribution, (unsigned long long)nb_executions, ns_per_execution, bytes_per_execution);
+}
+
+static void measure_history(Distribution distribution, uint64_t nb_executions)
+{
+	std::vector<RunningEntry>	executions = generate_executions(distribution, nb_executions);
+	std::vector<RunningEntry>	merged_executions;
+	uint64_t					nb_repetitions = std::max(minimum_nb_measured_executions / nb_executions, (uint64_t)1);
+	const char*					name = distribution_names[(size_t)distribution];
+
+	// Merge
+	{
+		double	total_ns = 0.0;
+		size_t	capacity = 0;
+
+		for (uint64_t repetition = 0; repetition < nb_repetitions; repetition++)
+		{
+			merged_executions.clear();
+			merged_executions.shrink_to_fit(); // Growth of the history is part of the cost
+
+			auto start = std::chrono::steady_clock::now();
+			for (const RunningEntry& execution : executions)
+				insert_merge_entry(merged_executions, execution);
+			auto end = std::chrono::steady_clock::now();
+
+			total_ns += std::chrono::duration<double, std::nano>(end - start).count();
+			capacity = merged_executions.capacity();
+		}
+		print_result("insert_merge_entry", name, nb_executions, total_ns / (nb_repetitions * nb_executions),
+			(double)(capacity * sizeof(RunningEntry)) / nb_executions);
+	}
+
+	// Aggregation of the whole history, resources are the executions before merge
+	{
+		std::vector<Execution_Resources>	resources(nb_executions);
+		std::vector<Period_Bucket>			buckets;
+
+		for (uint64_t i = 0; i < nb_executions; i++)
+			resources[i] = { executions[i].start_time, executions[i].end_time, i, i, (uint32_t)i, 1, 1024, 0 };
+		std::sort(resources.begin(), resources.end(),
+			[](const Execution_Resources& a, const Execution_Resources& b) { return a.start_time < b.start_time; });
+
+		uint64_t first_date = WindowsTickToUnixSeconds(merged_executions.front().start_time);
+		uint64_t last_date = WindowsTickToUnixSeconds(merged_executions.back().end_time);
+		uint64_t period_duration = std::max((last_date - first_date) / nb_aggregated_periods, (uint64_t)1);
+		uint64_t first_period = first_date / period_duration;
+		uint64_t end_period = last_date / period_duration + 1;
+		double	 total_ns = 0.0;
+
+		for (uint64_t repetition = 0; repetition < nb_repetitions; repetition++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			aggregate_periods(merged_executions, resources, period_duration, first_period, end_period, buckets, []() { return false; });
+			auto end = std::chrono::steady_clock::now();
+
+			total_ns += std::chrono::duration<double, std::nano>(end - start).count();
+		}
+		print_result("aggregate_periods", name, nb_executions, total_ns / (nb_repetitions * nb_executions),
+			(double)(merged_executions.size() * sizeof(RunningEntry) + resources.size() * sizeof(Execution_Resources)) / nb_executions);
+	}
+}
+
+static void measure_period_duration()
+{
+	uint64_t	random = 1;
+	uint64_t	sum = 0;
+	auto		start = std::chrono::steady_clock::now();
+
+	for (uint64_t i = 0; i < nb_period_duration_calls; i++)
+	{
+		double range_start = (double)start_date;
+		double range_end = range_start + (double)(next_random(random) % (20 * (uint64_t)year_duration));
+
+		sum += get_optimal_period_duration(range_start, range_end);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	if (sum == 0) // Prevent the optimizer from removing the loop
+		printf("!");
+	print_result("get_optimal_period_duration", "random_ranges", nb_period_duration_calls,
+		std::chrono::duration<double, std::nano>(end - start).count() / nb_period_duration_calls, 0.0);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t maximum_nb_executions = 10'000'000;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--csv") == 0)
+			is_csv = true;
+		else
+			maximum_nb_executions = std::strtoull(argv[i], nullptr, 10);
+	}
+
+	if (is_csv)
+		printf("kernel,distribution,nb_executions,ns_per_execution,bytes_per_execution\n");
+	else
+		printf("%-28s %-14s %12s %14s %14s\n", "kernel", "distribution", "executions", "ns/execution", "bytes/execution");
+
+	for (uint64_t nb_executions = 1000; nb_executions <= maximum_nb_executions; nb_executions *= 10)
+		for (Distribution distribution : { Distribution::in_order, Distribution::out_of_order, Distribution::overlapping, Distribution::bursty })
+			measure_history(distribution, nb_executions);
+	measure_period_duration();
+	return 0;
+}
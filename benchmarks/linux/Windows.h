@@ -0,0 +1,192 @@
+#pragma once
+
+// Subset of the Win32 API used by the UI and the view thread, implemented with the standard library so
+// benchmarks that drive them can run on Linux (CI machines without GPU nor window).
+// @Warning Only for benchmarks, the application itself is built against the real Windows.h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+
+typedef long		LONG;
+typedef unsigned long	DWORD;
+typedef int			BOOL;
+typedef unsigned int	UINT;
+typedef void*		LPVOID;
+
+#define WINAPI
+#define TRUE			1
+#define FALSE			0
+#define INFINITE		0xFFFFFFFF
+#define WAIT_OBJECT_0	0
+#define WAIT_TIMEOUT	258
+#define CP_UTF8			65001
+
+// Critical sections are recursive as on Windows
+struct CRITICAL_SECTION
+{
+	std::recursive_mutex* mutex = nullptr;
+};
+
+inline void InitializeCriticalSection(CRITICAL_SECTION* critical_section) { critical_section->mutex = new std::recursive_mutex; }
+inline void DeleteCriticalSection(CRITICAL_SECTION* critical_section) { delete critical_section->mutex; critical_section->mutex = nullptr; }
+inline void EnterCriticalSection(CRITICAL_SECTION* critical_section) { critical_section->mutex->lock(); }
+inline BOOL TryEnterCriticalSection(CRITICAL_SECTION* critical_section) { return critical_section->mutex->try_lock(); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* critical_section) { critical_section->mutex->unlock(); }
+
+inline LONG InterlockedOr(volatile LONG* value, LONG mask) { return __atomic_fetch_or(value, mask, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchange(volatile LONG* value, LONG new_value) { return __atomic_exchange_n(value, new_value, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedIncrement(volatile LONG* value) { return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedDecrement(volatile LONG* value) { return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST); }
+
+// Events and threads are waitable handles, a single condition variable wakes up all waiters
+struct Win32_Handle
+{
+	bool		is_thread = false;
+	bool		is_manual_reset = false;
+	bool		is_signaled = false; // Finished for a thread
+	std::thread	thread;
+};
+typedef Win32_Handle* HANDLE;
+
+inline std::mutex&				get_handles_mutex() { static std::mutex mutex; return mutex; }
+inline std::condition_variable&	get_handles_condition() { static std::condition_variable condition; return condition; }
+
+inline HANDLE CreateEvent(void*, BOOL manual_reset, BOOL initial_state, const void*)
+{
+	HANDLE handle = new Win32_Handle;
+
+	handle->is_manual_reset = manual_reset;
+	handle->is_signaled = initial_state;
+	return handle;
+}
+
+inline BOOL SetEvent(HANDLE handle)
+{
+	{
+		std::lock_guard<std::mutex> lock(get_handles_mutex());
+		handle->is_signaled = true;
+	}
+	get_handles_condition().notify_all();
+	return TRUE;
+}
+
+inline BOOL ResetEvent(HANDLE handle)
+{
+	std::lock_guard<std::mutex> lock(get_handles_mutex());
+	handle->is_signaled = false;
+	return TRUE;
+}
+
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+
+inline HANDLE CreateThread(void*, size_t, LPTHREAD_START_ROUTINE function, LPVOID parameter, DWORD, DWORD*)
+{
+	HANDLE handle = new Win32_Handle;
+
+	handle->is_thread = true;
+	handle->thread = std::thread([handle, function, parameter]() {
+		function(parameter);
+		{
+			std::lock_guard<std::mutex> lock(get_handles_mutex());
+			handle->is_signaled = true;
+		}
+		get_handles_condition().notify_all();
+	});
+	return handle;
+}
+
+inline DWORD WaitForMultipleObjects(DWORD nb_handles, const HANDLE* handles, BOOL, DWORD timeout_ms)
+{
+	std::unique_lock<std::mutex>	lock(get_handles_mutex());
+	DWORD							index = nb_handles;
+	auto							is_signaled = [&]() {
+		for (index = 0; index < nb_handles && !handles[index]->is_signaled; index++)
+			;
+		return index < nb_handles;
+	};
+
+	if (timeout_ms == INFINITE)
+		get_handles_condition().wait(lock, is_signaled);
+	else if (!get_handles_condition().wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms), is_signaled))
+		return WAIT_TIMEOUT;
+
+	if (!handles[index]->is_thread && !handles[index]->is_manual_reset)
+		handles[index]->is_signaled = false;
+	return WAIT_OBJECT_0 + index;
+}
+
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD timeout_ms)
+{
+	return WaitForMultipleObjects(1, &handle, FALSE, timeout_ms);
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+	if (handle->is_thread && handle->thread.joinable())
+		handle->thread.join();
+	delete handle;
+	return TRUE;
+}
+
+inline void Sleep(DWORD ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// wchar_t is UTF-32 on Linux, only CP_UTF8 is supported
+inline int WideCharToMultiByte(UINT, DWORD, const wchar_t* string, int length, char* buffer, int buffer_size, const char*, BOOL*)
+{
+	int size = 0;
+
+	for (int i = 0; i < length; i++)
+	{
+		uint32_t	code_point = (uint32_t)string[i];
+		char		bytes[4];
+		int			nb_bytes;
+
+		if (code_point < 0x80)
+		{
+			bytes[0] = (char)code_point;
+			nb_bytes = 1;
+		}
+		else if (code_point < 0x800)
+		{
+			bytes[0] = (char)(0xC0 | (code_point >> 6));
+			bytes[1] = (char)(0x80 | (code_point & 0x3F));
+			nb_bytes = 2;
+		}
+		else if (code_point < 0x10000)
+		{
+			bytes[0] = (char)(0xE0 | (code_point >> 12));
+			bytes[1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+			bytes[2] = (char)(0x80 | (code_point & 0x3F));
+			nb_bytes = 3;
+		}
+		else
+		{
+			bytes[0] = (char)(0xF0 | (code_point >> 18));
+			bytes[1] = (char)(0x80 | ((code_point >> 12) & 0x3F));
+			bytes[2] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+			bytes[3] = (char)(0x80 | (code_point & 0x3F));
+			nb_bytes = 4;
+		}
+
+		// A size of 0 only computes the needed size
+		if (buffer_size)
+		{
+			if (size + nb_bytes > buffer_size)
+				return 0;
+			for (int j = 0; j < nb_bytes; j++)
+				buffer[size + j] = bytes[j];
+		}
+		size += nb_bytes;
+	}
+	return size;
+}
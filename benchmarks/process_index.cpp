@@ -0,0 +1,107 @@
+// Compare the lookup of process names done for every process creation:
+//  - legacy: lower case copy of the name, then a probe in the set of each group
+//  - index: single probe in the Process_Index (exact names only)
+//  - index + patterns: same with glob patterns in every group, matched by the lazy DFA
+//
+// Build: cl /std:c++latest /O2 /EHsc benchmarks\process_index.cpp sources\process_index.cpp
+//        g++ -std=c++20 -O2 benchmarks/process_index.cpp sources/process_index.cpp
+
+#include "../sources/process_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct Group
+{
+	std::unordered_set<std::wstring> proccess_names;
+};
+
+constexpr size_t nb_groups = 300;
+constexpr size_t nb_lookups = 2'000'000;
+
+static std::vector<std::wstring> generate_machine_process_names()
+{
+	// Mostly untracked processes, as on a real machine
+	std::vector<std::wstring> names = {
+		L"svchost.exe", L"RuntimeBroker.exe", L"explorer.exe", L"chrome.exe", L"conhost.exe",
+		L"SearchProtocolHost.exe", L"backgroundTaskHost.exe", L"WmiPrvSE.exe", L"git.exe", L"sh.exe",
+		L"CL.exe", L"link.exe", L"clang++.exe", L"x86_64-linux-gnu-g++-12", L"MSBuild.exe",
+	};
+	return names;
+}
+
+template<typename Function>
+static double measure_ns_per_lookup(const std::vector<std::wstring>& names, Function function)
+{
+	size_t nb_found = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < nb_lookups; i++)
+		nb_found += function(names[i % names.size()]) ? 1 : 0;
+
+	auto end = std::chrono::steady_clock::now();
+	if (nb_found == (size_t)-1) // Prevent the optimizer from removing the loop
+		printf("!");
+	return std::chrono::duration<double, std::nano>(end - start).count() / nb_lookups;
+}
+
+int main()
+{
+	std::vector<Group>			groups(nb_groups);
+	std::vector<std::wstring>	names = generate_machine_process_names();
+
+	for (size_t i = 0; i < nb_groups; i++)
+	{
+		groups[i].proccess_names.insert(L"tool_" + std::to_wstring(i) + L".exe");
+		groups[i].proccess_names.insert(L"helper_" + std::to_wstring(i) + L".exe");
+	}
+	groups[nb_groups - 1].proccess_names.insert(L"cl.exe");
+	groups[nb_groups - 1].proccess_names.insert(L"link.exe");
+
+	double legacy_ns = measure_ns_per_lookup(names, [&](const std::wstring& name) -> Group* {
+		std::wstring lower_name = name;
+
+		std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
+		for (Group& group : groups)
+		{
+			if (group.proccess_names.find(lower_name) != group.proccess_names.end())
+				return &group;
+		}
+		return nullptr;
+	});
+
+	Process_Index index;
+	index.clear();
+	for (Group& group : groups)
+		index.set_group_processes(&group, group.proccess_names);
+
+	double index_ns = measure_ns_per_lookup(names, [&](const std::wstring& name) {
+		return index.find(name);
+	});
+
+	for (size_t i = 0; i < nb_groups; i++)
+	{
+		groups[i].proccess_names.insert(L"gen" + std::to_wstring(i) + L"_*.exe");
+		groups[i].proccess_names.insert(L"*-cc" + std::to_wstring(i));
+	}
+	groups[0].proccess_names.insert(L"clang*");
+	groups[1].proccess_names.insert(L"*-g++-12");
+	groups[2].proccess_names.insert(L"link*.exe");
+	for (Group& group : groups)
+		index.set_group_processes(&group, group.proccess_names);
+
+	double patterns_ns = measure_ns_per_lookup(names, [&](const std::wstring& name) {
+		return index.find(name);
+	});
+
+	printf("%zu groups, %zu lookups\n", nb_groups, nb_lookups);
+	printf("legacy (copy + probe per group)  : %8.1f ns/lookup\n", legacy_ns);
+	printf("index (exact names)              : %8.1f ns/lookup\n", index_ns);
+	printf("index + %4zu patterns             : %8.1f ns/lookup (%zu DFA states)\n",
+		index.glob_matcher.patterns.size(), patterns_ns, index.glob_matcher.dfa_states.size());
+	return 0;
+}
@@ -0,0 +1,250 @@
+// Headless daemon for build servers: groups bound to cgroups (v2) are captured by Cgroup_Tracker, their
+// activities are merged in the history of the groups and the records are checkpointed periodically, there
+// is no window nor UI at all. The record file has the format of the application, it can be copied on a
+// Windows machine to be viewed there.
+//
+// Usage: dear_time_daemon [--records path] [--checkpoint seconds] --group name=cgroup_path...
+//  --records: default /var/lib/dear_time/records.dat, or records.dat in $STATE_DIRECTORY (systemd)
+//  --checkpoint: delay between backups of the records, default 300 seconds
+//  --group: a group of the records (created if needed) recording activities of the cgroup, like
+//           --group "Build=/sys/fs/cgroup/system.slice/build.scope", it can be created (or created again) later
+// SIGINT and SIGTERM stop the daemon after a last checkpoint, activities still running are not recorded.
+//
+// Build (Linux only, g++ 13 or later for <format>), the engine library then the daemon:
+//  g++ -std=c++20 -O2 -DNDEBUG -c sources/capture_lag.cpp sources/cgroup.cpp sources/concurrency.cpp sources/concurrent_pid_map.cpp
+//     sources/group.cpp sources/intervals.cpp sources/process_index.cpp sources/records.cpp sources/trace.cpp
+//  ar rcs libdear_time_engine.a capture_lag.o cgroup.o concurrency.o concurrent_pid_map.o group.o intervals.o process_index.o
+//     records.o trace.o
+//  g++ -std=c++20 -O2 -DNDEBUG -pthread daemon/main.cpp libdear_time_engine.a -o dear_time_daemon
+// SIGUSR1 saves the histograms of the capture lag in capture_lag.csv next to the records.
+// With -D_DEBUG instead of -DNDEBUG the tests of the engine run at startup. With -DDEAR_TIME_TRACING (both
+// steps) SIGUSR1 also saves the last tracing zones in trace.json.
+
+#include "../sources/group.h"
+#include "../sources/capture_lag.h"
+#include "../sources/records.h"
+#include "../sources/cgroup.h"
+#include "../sources/concurrency.h"
+#include "../sources/concurrent_pid_map.h"
+#include "../sources/process_index.h"
+#include "../sources/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <csignal>
+
+constexpr int wait_timeout_ms = 1000; // Stop requests are checked at least this often
+
+struct Bound_Group
+{
+	Group*			group;
+	std::string		cgroup_path;
+	std::wstring	executable; // Name of the cgroup, the "executable" of its activities
+};
+
+static volatile std::sig_atomic_t is_stop_requested = 0;
+
+static void on_stop_signal(int)
+{
+	is_stop_requested = 1;
+}
+
+static volatile std::sig_atomic_t is_export_requested = 0;
+
+static void on_export_signal(int)
+{
+	is_export_requested = 1;
+}
+
+#if defined(_DEBUG)
+static void run_tests()
+{
+	test_intervals();
+	test_group();
+	test_capture_lag();
+	test_records();
+	test_trace();
+	test_process_index();
+	test_concurrent_pid_map();
+	test_concurrency_timeline();
+	test_cgroup();
+}
+#endif
+
+static std::filesystem::path get_default_records_path()
+{
+	const char* state_directory = std::getenv("STATE_DIRECTORY");
+
+	if (state_directory && *state_directory)
+		return std::filesystem::path(state_directory) / "records.dat";
+	return "/var/lib/dear_time/records.dat";
+}
+
+static Group* find_or_create_group(Records& records, const std::string& name)
+{
+	for (Group* group : records.groups)
+	{
+		if (group->name == name)
+			return group;
+	}
+
+	Group* group = new Group();
+
+	group->name = name;
+	records.groups.push_back(group);
+	return group;
+}
+
+static bool checkpoint(const std::filesystem::path& records_path, const Records& records)
+{
+	if (save_records(records_path, records.groups, records.current_group_name))
+		return true;
+	fprintf(stderr, "dear_time_daemon: failed to write %s\n", records_path.c_str());
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+#if defined(_DEBUG)
+	run_tests();
+#endif
+
+	std::filesystem::path					records_path = get_default_records_path();
+	uint64_t								checkpoint_delay_s = 300;
+	std::vector<std::pair<std::string, std::string>>	group_bindings; // Name and cgroup path
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--records") == 0 && i + 1 < argc)
+			records_path = argv[++i];
+		else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+			checkpoint_delay_s = std::max(std::strtoull(argv[++i], nullptr, 10), 1ull);
+		else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc && strchr(argv[i + 1], '='))
+		{
+			const char* binding = argv[++i];
+			const char* separator = strchr(binding, '=');
+
+			group_bindings.emplace_back(std::string(binding, separator), std::string(separator + 1));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: dear_time_daemon [--records path] [--checkpoint seconds] --group name=cgroup_path...\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (group_bindings.empty())
+	{
+		fprintf(stderr, "dear_time_daemon: no group to track\n");
+		return EXIT_FAILURE;
+	}
+
+	std::error_code error;
+
+	std::filesystem::create_directories(records_path.parent_path(), error);
+
+	Records records;
+
+	if (!load_records(records_path, records) && std::filesystem::exists(records_path))
+	{
+		fprintf(stderr, "dear_time_daemon: %s is invalid, it is not overwritten\n", records_path.c_str());
+		return EXIT_FAILURE;
+	}
+
+	// Ids of the tracker are indices in bound_groups
+	Cgroup_Tracker				tracker;
+	std::vector<Bound_Group>	bound_groups;
+
+	if (!tracker.initialize())
+	{
+		fprintf(stderr, "dear_time_daemon: inotify isn't available\n");
+		return EXIT_FAILURE;
+	}
+
+	for (const auto& [name, cgroup_path] : group_bindings)
+	{
+		Bound_Group bound_group;
+
+		bound_group.group = find_or_create_group(records, name);
+		bound_group.cgroup_path = cgroup_path;
+		bound_group.executable = std::filesystem::path(cgroup_path).filename().wstring();
+		// A transient scope can be created after the daemon
+		if (!tracker.watch((uint32_t)bound_groups.size(), cgroup_path))
+			fprintf(stderr, "dear_time_daemon: %s doesn't exist yet, it will be watched when it is created\n", cgroup_path.c_str());
+		bound_groups.push_back(std::move(bound_group));
+	}
+
+	struct sigaction stop_action = {};
+
+	stop_action.sa_handler = &on_stop_signal;
+	sigaction(SIGINT, &stop_action, nullptr);
+	sigaction(SIGTERM, &stop_action, nullptr);
+
+	struct sigaction export_action = {};
+
+	export_action.sa_handler = &on_export_signal;
+	sigaction(SIGUSR1, &export_action, nullptr);
+
+	TRACE_THREAD_NAME("Daemon");
+
+	std::vector<Cgroup_Activity>	activities;
+	auto							checkpoint_delay = std::chrono::seconds(checkpoint_delay_s);
+	auto							next_checkpoint = std::chrono::steady_clock::now() + checkpoint_delay;
+	bool							has_changes = false;
+
+	while (!is_stop_requested)
+	{
+		tracker.wait(wait_timeout_ms, activities);
+
+		for (const Cgroup_Activity& activity : activities)
+		{
+			const Bound_Group&	bound_group = bound_groups[activity.group_id];
+			Execution_Resources	resources = { activity.start_time, activity.end_time, 0, 0, activity.user_time_ms, activity.kernel_time_ms, 0, 0 };
+
+			add_pending_execution(bound_group.group, bound_group.executable, { activity.start_time, activity.end_time }, resources, activity.end_time);
+		}
+		activities.clear();
+
+		// This thread is the only one recording executions, they are merged as soon as they end (the end of
+		// an activity is dated when it is seen, there is no termination lag)
+		{
+			TRACE_ZONE("merge_pending_executions");
+
+			for (const Bound_Group& bound_group : bound_groups)
+				has_changes |= merge_pending_executions(bound_group.group) != UINT64_MAX;
+		}
+
+		if (is_export_requested)
+		{
+			is_export_requested = 0;
+			if (!save_capture_lag_histograms(records_path.parent_path() / "capture_lag.csv"))
+				fprintf(stderr, "dear_time_daemon: failed to write the capture lag\n");
+#if defined(DEAR_TIME_TRACING)
+			if (!save_chrome_trace(records_path.parent_path() / "trace.json"))
+				fprintf(stderr, "dear_time_daemon: failed to write the trace\n");
+#endif
+		}
+
+		if (std::chrono::steady_clock::now() >= next_checkpoint)
+		{
+			TRACE_ZONE("checkpoint");
+
+			if (has_changes && checkpoint(records_path, records))
+				has_changes = false;
+			next_checkpoint = std::chrono::steady_clock::now() + checkpoint_delay;
+		}
+	}
+
+	tracker.terminate();
+	checkpoint(records_path, records);
+	for (Group* group : records.groups)
+		delete group;
+	return EXIT_SUCCESS;
+}
@@ -1,6 +1,9 @@
 #include "application.h"
 
+#include "records.h"
+#include "trace.h"
 #include "utils.h"
+#include "view.h"
 
 #include <algorithm>
 #include <string>
@@ -13,7 +16,8 @@
 
 #include <Shlobj.h>
 
-constexpr uint32_t record_format_version = 0;
+static void register_group_id(Group* group);
+static void unregister_group_id(Group* group);
 
 void initialize_application()
 {
@@ -33,86 +37,31 @@ void initialize_application()
 	g_dear_time.record_file_path = g_dear_time.app_data_folder_path + std::wstring(L"\\records.dat");
 
 	{
-		HANDLE hFile = CreateFileW(g_dear_time.record_file_path.c_str(), // name of the write
-			GENERIC_READ,           // open for reading
-			0,                      // do not share
-			NULL,                   // default security
-			OPEN_EXISTING,          // open only existing
-			FILE_ATTRIBUTE_NORMAL,  // normal file
-			NULL);                  // no attr. template
-
-		if (hFile != INVALID_HANDLE_VALUE)
-		{
-			DWORD dwBytesRead;
-
-			char magic_number[5];
-			ReadFile(hFile, &magic_number[0], sizeof(magic_number), &dwBytesRead, NULL);
-
-			if (strncmp(magic_number, "DTIME", 5) == 0)
-			{
-				uint32_t file_format_version;
-
-				ReadFile(hFile, &file_format_version, sizeof(file_format_version), &dwBytesRead, NULL);
-
-				uint32_t nb_groups;
-				ReadFile(hFile, &nb_groups, sizeof(nb_groups), &dwBytesRead, NULL);
-				for (uint32_t group_index = 0; group_index < nb_groups; group_index++)
-				{
-					Group* group = new Group();
-
-					uint32_t group_name_size;
-					ReadFile(hFile, &group_name_size, sizeof(group_name_size), &dwBytesRead, NULL);
-
-					group->name.resize(group_name_size);
-					ReadFile(hFile, group->name.data(), group_name_size * sizeof(*group->name.data()), &dwBytesRead, NULL);
-
-					uint32_t nb_process_names;
-					ReadFile(hFile, &nb_process_names, sizeof(nb_process_names), &dwBytesRead, NULL);
-					for (uint32_t process_name_index = 0; process_name_index < nb_process_names; process_name_index++)
-					{
-						uint32_t process_name_size;
-						ReadFile(hFile, &process_name_size, sizeof(process_name_size), &dwBytesRead, NULL);
-						std::wstring process_name;
-
-						process_name.resize(process_name_size);
-						ReadFile(hFile, process_name.data(), process_name_size * sizeof(*process_name.data()), &dwBytesRead, NULL);
-						group->proccess_names.insert(process_name);
-					}
+		Records records;
 
-					uint32_t nb_merged_executions;
-
-					ReadFile(hFile, &nb_merged_executions, sizeof(nb_merged_executions), &dwBytesRead, NULL);
-					group->merged_executions.resize(nb_merged_executions);
-					ReadFile(hFile, group->merged_executions.data(), nb_merged_executions * sizeof(*group->merged_executions.data()), &dwBytesRead, NULL);
-
-					InitializeCriticalSection(&group->executions_critical_section);
-					g_dear_time.groups.insert(std::make_pair(group->name, group));
-				}
-
-				// Selected group name
-				{
-					uint32_t group_name_size;
-					ReadFile(hFile, &group_name_size, sizeof(group_name_size), &dwBytesRead, NULL);
-
-					g_dear_time.current_group_name.resize(group_name_size);
-					ReadFile(hFile, g_dear_time.current_group_name.data(), group_name_size * sizeof(*g_dear_time.current_group_name.data()), &dwBytesRead, NULL);
-				}
-			}
+		load_records(g_dear_time.record_file_path, records);
+		for (Group* group : records.groups)
+		{
+			if (group->track_process_tree)
+				g_dear_time.nb_process_tree_groups++;
+			g_dear_time.groups.insert(std::make_pair(group->name, group));
+			register_group_id(group);
+			g_dear_time.process_index.set_group_processes(group, group->proccess_names);
 		}
-
-		CloseHandle(hFile);
+		g_dear_time.current_group_name = std::move(records.current_group_name);
 	}
 
 	// Create the empty group
 	{
 		g_dear_time.empty_group = new Group();
 		g_dear_time.empty_group->name = "";
-		InitializeCriticalSection(&g_dear_time.empty_group->executions_critical_section);
+		g_dear_time.empty_group->id = 0xffffffff; // Never registered, no frame is prepared for it
 	}
 
 	// Initialize atomic variables
 	g_dear_time.nb_requested_redraws = (LONG*)_aligned_malloc(4, 32);
 	InterlockedExchange(g_dear_time.nb_requested_redraws, min_nb_redraws);
+	g_dear_time.redraw_event = CreateEvent(NULL, FALSE, FALSE, NULL);
 }
 
 // This method is suceptible to use the 'done_by_end_session' flag to do only critical operations
@@ -127,66 +76,21 @@ void shutdown_application()
 
 void safe_backup()
 {
+	TRACE_ZONE("safe_backup");
+
 	// @TODO check errors
 
 	// Backup records
-	HANDLE hFile = CreateFileW(g_dear_time.record_file_path.c_str(), // name of the write
-		GENERIC_WRITE,          // open for writing
-		0,                      // do not share
-		NULL,                   // default security
-		CREATE_ALWAYS,			// create or open and truncate
-		FILE_ATTRIBUTE_NORMAL,  // normal file
-		NULL);                  // no attr. template
-
-	DWORD dwBytesWritten;
+	std::vector<Group*> groups;
 
-	WriteFile(hFile, "DTIME", 5, &dwBytesWritten, NULL);
-	WriteFile(hFile, &record_format_version, sizeof(record_format_version), &dwBytesWritten, NULL);
-
-	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	enter_editing_groups_critical_section();
 	{
-		uint32_t nb_groups = (uint32_t)g_dear_time.groups.size();
-		WriteFile(hFile, &nb_groups, sizeof(nb_groups), &dwBytesWritten, NULL);
-		for (auto group_pair : g_dear_time.groups)
-		{
-			uint32_t group_name_size = (uint32_t)group_pair.first.size();
-
-			WriteFile(hFile, &group_name_size, sizeof(group_name_size), &dwBytesWritten, NULL);
-			WriteFile(hFile, group_pair.first.data(), group_name_size * sizeof(*group_pair.first.data()), &dwBytesWritten, NULL);
-
-			uint32_t nb_process_names = (uint32_t)group_pair.second->proccess_names.size();
-
-			WriteFile(hFile, &nb_process_names, sizeof(nb_process_names), &dwBytesWritten, NULL);
-			for (const auto& process_name : group_pair.second->proccess_names)
-			{
-				uint32_t process_name_size = (uint32_t)process_name.size();
-
-				WriteFile(hFile, &process_name_size, sizeof(process_name_size), &dwBytesWritten, NULL);
-				WriteFile(hFile, process_name.data(), process_name_size * sizeof(*process_name.data()), &dwBytesWritten, NULL);
-			}
-
-			Group* tracking_group = group_pair.second;
-			EnterCriticalSection(&tracking_group->executions_critical_section);
-			{
-				uint32_t nb_merged_executions = (uint32_t)tracking_group->merged_executions.size();
-
-				WriteFile(hFile, &nb_merged_executions, sizeof(nb_merged_executions), &dwBytesWritten, NULL);
-				WriteFile(hFile, tracking_group->merged_executions.data(), nb_merged_executions * sizeof(*tracking_group->merged_executions.data()), &dwBytesWritten, NULL);
-			}
-			LeaveCriticalSection(&tracking_group->executions_critical_section);
-		}
+		groups.reserve(g_dear_time.groups.size());
+		for (const auto& group_pair : g_dear_time.groups)
+			groups.push_back(group_pair.second);
+		save_records(g_dear_time.record_file_path, groups, g_dear_time.current_group_name);
 	}
 	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
-
-	// Selected group name
-	{
-		uint32_t group_name_size = (uint32_t)g_dear_time.current_group_name.size();
-
-		WriteFile(hFile, &group_name_size, sizeof(group_name_size), &dwBytesWritten, NULL);
-		WriteFile(hFile, g_dear_time.current_group_name.data(), group_name_size * sizeof(*g_dear_time.current_group_name.data()), &dwBytesWritten, NULL);
-	}
-
-	CloseHandle(hFile);
 }
 
 
@@ -201,21 +105,57 @@ Group* get_tracking_group(const std::string& name)
 	return it->second;
 }
 
-Group* get_tracking_group_by_process(const std::wstring& process_name)
+Group* get_tracking_group_by_id(uint32_t id)
 {
-	// @TODO @SpeedUp should be able to take the parameter as string_view, but we actually can't mix key
-	// types even when they are compatibles for comparison and hashing.
+	uint32_t index = id & 0xffff;
+
+	if (index >= g_dear_time.groups_by_id.size() || g_dear_time.group_id_generations[index] != (id >> 16))
+		return nullptr;
+	return g_dear_time.groups_by_id[index];
+}
 
-	std::wstring lower_name = process_name;
+// @Warning Should be called with editing_groups_critical_section locked
+void register_group_id(Group* group)
+{
+	auto it = std::find(g_dear_time.groups_by_id.begin(), g_dear_time.groups_by_id.end(), nullptr);
+	uint32_t index = (uint32_t)std::distance(g_dear_time.groups_by_id.begin(), it);
 
-	std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
-	for (auto it_group : g_dear_time.groups)
+	if (it == g_dear_time.groups_by_id.end())
 	{
-		if (it_group.second->proccess_names.find(lower_name) != it_group.second->proccess_names.end())
-			return it_group.second;
+		g_dear_time.groups_by_id.push_back(nullptr);
+		g_dear_time.group_id_generations.push_back(0);
 	}
+	assert(index <= 0xffff);
+
+	g_dear_time.groups_by_id[index] = group;
+	group->id = index | ((uint32_t)g_dear_time.group_id_generations[index] << 16);
+}
+
+// @Warning Should be called with editing_groups_critical_section locked
+void unregister_group_id(Group* group)
+{
+	uint32_t index = group->id & 0xffff;
 
-	return nullptr;
+	g_dear_time.groups_by_id[index] = nullptr;
+	g_dear_time.group_id_generations[index]++;
+}
+
+void record_execution(uint32_t group_id, uint32_t process_name_id, const RunningEntry& entry, Execution_Resources resources, uint64_t termination_time)
+{
+	Group* tracking_group = get_tracking_group_by_id(group_id);
+
+	if (!tracking_group) // Group may have been destroyed
+		return;
+
+	add_pending_execution(tracking_group, g_dear_time.process_names.get_name(process_name_id), entry, resources, termination_time);
+
+	request_view_update();
+}
+
+const Group_List* get_tracking_groups_by_process(std::wstring_view process_name)
+{
+	// Called for every process created on the machine, untracked ones are rejected by a single probe
+	return g_dear_time.process_index.find(process_name);
 }
 
 std::string	create_new_group()
@@ -237,13 +177,13 @@ bool create_group(const std::string& name)
 	if (g_dear_time.groups.find(name.c_str()) != g_dear_time.groups.end())
 		return false;
 
-	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	enter_editing_groups_critical_section();
 	{
 		Group* new_group = new Group();
 
 		new_group->name = name;
-		InitializeCriticalSection(&new_group->executions_critical_section);
 		g_dear_time.groups.insert(std::make_pair(name, new_group));
+		register_group_id(new_group);
 	}
 	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
 
@@ -258,12 +198,15 @@ std::string delete_group(const std::string& name)
 		return "";
 
 	std::unordered_map<std::string, Group*>::iterator next_it;
-	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	enter_editing_groups_critical_section();
 	{
 		Group* group = it->second;
 
-		DeleteCriticalSection(&group->executions_critical_section);
-		delete group;
+		g_dear_time.process_index.remove_group(group);
+		unregister_group_id(group);
+		if (group->track_process_tree)
+			g_dear_time.nb_process_tree_groups--;
+		g_dear_time.retired_groups.push_back(group);
 
 		next_it = g_dear_time.groups.erase(it);
 	}
@@ -292,7 +235,7 @@ Rename_Errors rename_group(const std::string& name, const std::string& new_name)
 		return Rename_Errors::error_not_found;
 	}
 
-	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	enter_editing_groups_critical_section();
 	{
 		Group* group = it->second;
 
@@ -305,6 +248,63 @@ Rename_Errors rename_group(const std::string& name, const std::string& new_name)
 	return Rename_Errors::no_error;
 }
 
+template<typename Container>
+static void format_semicolon_list(const Container& names, char* buffer, size_t buffer_size)
+{
+	size_t pos = 0;
+
+	for (const auto& name : names)
+	{
+		size_t separator_size = pos > 0 ? 1 : 0;
+
+		// Converted in place without temporary string, the ';' and the ending '\0' should still fit
+		// @Warning A size of 0 would query the needed size instead of converting
+		if (pos + separator_size + 2 >= buffer_size)
+			break;
+
+		int size = WideCharToMultiByte(CP_UTF8, 0, name.data(), (int)name.size(),
+			&buffer[pos + separator_size], (int)(buffer_size - pos - separator_size - 2), NULL, NULL);
+		if (size == 0 && !name.empty())
+			break;
+
+		if (separator_size)
+			buffer[pos] = ' ';
+		pos += separator_size + size;
+		buffer[pos++] = ';';
+	}
+	if (pos > 0)
+		buffer[pos - 1] = '\0'; // Erase the last ';'
+}
+
+// Names are trimmed and folded
+static Update_Processes_Errors parse_semicolon_list(const std::string& string, size_t string_maximum_length, std::vector<std::wstring>& names)
+{
+	auto split = split_string(string, ";");
+
+	using convert_type = std::codecvt_utf8<wchar_t>;
+	std::wstring_convert<convert_type, wchar_t> converter;
+
+	size_t string_size = 0;
+
+	names.reserve(split.size());
+	for (const auto& word : split) {
+		auto trimmed = trim(word);
+
+		std::wstring utf16 = converter.from_bytes(std::string(trimmed));
+
+		if (utf16.empty())
+			continue;
+
+		string_size += utf16.size();
+		if (string_size + names.size() * 2 >= string_maximum_length) // string_maximum_length - 1 because of ending '\0'
+			return Update_Processes_Errors::too_many_processes;
+
+		std::transform(utf16.begin(), utf16.end(), utf16.begin(), fold_process_name_char);
+		names.push_back(std::move(utf16));
+	}
+	return Update_Processes_Errors::no_error;
+}
+
 void get_processes_string(const std::string& group_name, char* buffer, size_t buffer_size)
 {
 	assert(buffer_size > 0);
@@ -317,31 +317,47 @@ void get_processes_string(const std::string& group_name, char* buffer, size_t bu
 		return;
 	}
 
-	Group* group = it->second;
-	size_t pos = 0;
+	format_semicolon_list(it->second->proccess_names, buffer, buffer_size);
+}
 
-	using convert_type = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_type, wchar_t> converter;
+Update_Processes_Errors udpate_processes(const std::string& group_name, const std::string& processes_string, size_t processes_string_maximum_length)
+{
+	auto it = g_dear_time.groups.find(group_name.c_str());
+	if (it == g_dear_time.groups.end()) {
+		return Update_Processes_Errors::group_not_found;
+	}
 
-	for (const auto& proccess_name : group->proccess_names)
+	Group* group = it->second;
+	std::vector<std::wstring> process_names;
+	Update_Processes_Errors result = parse_semicolon_list(processes_string, processes_string_maximum_length, process_names);
+
+	enter_editing_groups_critical_section();
 	{
-		std::string utf8 = converter.to_bytes(proccess_name);
+		group->proccess_names.clear();
+		group->proccess_names.insert(process_names.begin(), process_names.end());
+		g_dear_time.process_index.set_group_processes(group, group->proccess_names);
+	}
+	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
 
-		if (pos + group->proccess_names.size() * 2 - 2 > buffer_size)
-			return;
+	return result;
+}
 
-		if (pos  > 1)
-			buffer[pos++] = ' ';
+void get_command_line_predicates_string(const std::string& group_name, char* buffer, size_t buffer_size)
+{
+	assert(buffer_size > 0);
 
-		memcpy(&buffer[pos], utf8.c_str(), utf8.size());
-		pos += utf8.size();
-		buffer[pos++] = ';';
+	buffer[0] = '\0';
+
+	// @Warning As group editing methods should be called only from the main thread it is safe to read groups here
+	auto it = g_dear_time.groups.find(group_name.c_str());
+	if (it == g_dear_time.groups.end()) {
+		return;
 	}
-	if (pos > 0)
-		buffer[pos - 1] = '\0'; // Erase the last ';'
+
+	format_semicolon_list(it->second->command_line_predicates, buffer, buffer_size);
 }
 
-Update_Processes_Errors udpate_processes(const std::string& group_name, const std::string& processes_string, size_t processes_string_maximum_length)
+Update_Processes_Errors update_command_line_predicates(const std::string& group_name, const std::string& predicates_string, size_t predicates_string_maximum_length)
 {
 	auto it = g_dear_time.groups.find(group_name.c_str());
 	if (it == g_dear_time.groups.end()) {
@@ -349,38 +365,49 @@ Update_Processes_Errors udpate_processes(const std::string& group_name, const st
 	}
 
 	Group* group = it->second;
-	auto split = split_string(processes_string, ";");
-	size_t reformatted_size = 0;
+	std::vector<std::wstring> predicates;
+	Update_Processes_Errors result = parse_semicolon_list(predicates_string, predicates_string_maximum_length, predicates);
 
-	using convert_type = std::codecvt_utf8<wchar_t>;
-	std::wstring_convert<convert_type, wchar_t> converter;
-
-	Update_Processes_Errors result = Update_Processes_Errors::no_error;
-	size_t string_size = 0;
-
-	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+	enter_editing_groups_critical_section();
 	{
-		group->proccess_names.clear();
-		group->proccess_names.reserve(split.size());
-		for (const auto& word : split) {
-			auto trimmed = trim(word);
-
-			std::wstring utf16 = converter.from_bytes(std::string(trimmed));
+		group->command_line_predicates = std::move(predicates);
+	}
+	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
 
-			if (utf16.empty())
-				continue;
+	return result;
+}
 
-			string_size += utf16.size();
-			if (string_size + group->proccess_names.size() * 2 >= processes_string_maximum_length) // processes_string_maximum_length - 1 because of ending '\0'
-			{
-				result = Update_Processes_Errors::too_many_processes;
-				break;
-			}
+void update_freeze_detection(const std::string& group_name, uint32_t cpu_threshold_percent, uint32_t minimum_duration_ms)
+{
+	auto it = g_dear_time.groups.find(group_name.c_str());
+	if (it == g_dear_time.groups.end()) {
+		return;
+	}
 
-			group->proccess_names.insert(utf16);
-		}
+	// @Warning Processes already running keep the mode of the group at their creation
+	enter_editing_groups_critical_section();
+	{
+		it->second->freeze_cpu_threshold_percent = cpu_threshold_percent;
+		it->second->freeze_minimum_duration_ms = minimum_duration_ms;
 	}
 	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+}
 
-	return result;
+void update_track_process_tree(const std::string& group_name, bool track_process_tree)
+{
+	auto it = g_dear_time.groups.find(group_name.c_str());
+	if (it == g_dear_time.groups.end() || it->second->track_process_tree == track_process_tree) {
+		return;
+	}
+
+	// @Warning Running sessions continue until their processes terminate
+	enter_editing_groups_critical_section();
+	{
+		it->second->track_process_tree = track_process_tree;
+		if (track_process_tree)
+			g_dear_time.nb_process_tree_groups++;
+		else
+			g_dear_time.nb_process_tree_groups--;
+	}
+	LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
 }
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "time.h"
+#include "group.h"
+#include "process_index.h"
+#include "concurrency.h"
+#include "concurrent_pid_map.h"
+#include "diagnostics.h"
 
 #include <unordered_set>
 #include <unordered_map>
@@ -8,52 +13,17 @@
 #include <string_view>
 #include <vector>
 
-#include <Windows.h> // For CRITICAL_SECTION
+#include <Windows.h> // For CRITICAL_SECTION, HANDLE and Interlocked functions
 
 constexpr uint32_t min_nb_redraws = 3;
 
-constexpr uint64_t sleeping_duration_ms = 4;
-// 4 ms should reduce CPU usage by a lot and it is small enough to keep latency of UI low.
-// Notice that the maximum frequency will in every cases be limited by the rendering
-// performances and v-sync.
 
-struct RunningEntry
-{
-	uint64_t start_time; // Windows ticks (100 nanoseconds) since midnight on January 1, 1601 at Greenwich, England
-	uint64_t end_time; // Windows ticks (100 nanoseconds) since midnight on January 1, 1601 at Greenwich, England
-
-#if defined(_DEBUG)
-	// For tests (assert checks)
-	inline bool operator==(const RunningEntry& other) const
-	{
-		return this->start_time == other.start_time && this->end_time == other.end_time;
-	}
-#endif
-};
 
-struct Group
+// A running process that is part of a process tree tracked by a group (root or descendant)
+struct Process_Session
 {
-	std::string							name;
-	std::unordered_set<std::wstring>	proccess_names; // @Warning Should be lower case
-
-	CRITICAL_SECTION					executions_critical_section;
-	std::vector<RunningEntry>			executions;
-
-	std::vector<RunningEntry>			merged_executions;
-
-	// Only used by ui module
-	// Recomputed each "frame"
-
-	std::vector<double> plot_durations; // Interlaced starting dates and durations
-	std::vector<double> plot_merged_durations; // Interlaced starting dates and durations
-	double				bar_width;
-	Time_Unit			duration_unit;
-
-	uint64_t plot_range_duration;
-	uint64_t nb_executions;
-	uint64_t total_execution_time;
-	uint64_t maximum_duration;
-	double average_executions_time;
+	uint32_t group_id;
+	uint32_t generation; // Unique per insertion, a pid reused after a missed termination gets a new one
 };
 
 struct DearTime
@@ -74,13 +44,36 @@ struct DearTime
 	CRITICAL_SECTION	editing_groups_critical_section;
 
 	bool				groups_dialog = false;
+	bool				diagnostics_window = false;
 
 	std::wstring app_data_folder_path;
 	std::wstring record_file_path;
 	volatile LONG* nb_requested_redraws = nullptr;
+	volatile LONG nb_redraw_requests = 0; // Calls of request_redraw since the start, for the diagnostics window
+	uint64_t nb_drawn_frames = 0; // Main thread only, for the diagnostics window
+	uint64_t nb_ignored_messages = 0; // Window messages that can't change the output, they don't request frames
+	HANDLE redraw_event = NULL; // Auto reset, wakes up the main loop when a redraw is requested while it is idle
 
 	std::unordered_map<std::string, Group*> groups;
 	Group* empty_group;
+	std::vector<Group*> retired_groups; // Deleted, they are freed by the view thread that may still use them
+
+	// Tracking records reference groups by id, the generation of a slot is incremented when its group
+	// is deleted so a record of a deleted group is never attributed to a new one
+	std::vector<Group*>		groups_by_id;
+	std::vector<uint16_t>	group_id_generations;
+
+	// Names of tracked processes
+	Process_Name_Interner	process_names;
+
+	// Processes of tracked trees by pid, a process inherits the session of its parent on creation, so an
+	// ancestry check is a single lookup on the parent pid
+	Concurrent_Pid_Map<Process_Session>	process_sessions;
+	volatile LONG						process_session_generation = 0;
+	uint32_t							nb_process_tree_groups = 0; // Parents are only looked up when not 0
+
+	// Exact names and patterns of all groups
+	Process_Index process_index;
 
 	// ui
 	std::string current_group_name;
@@ -96,15 +89,34 @@ void safe_backup();
 
 // Helper functions
 Group*		get_tracking_group(const std::string& name);
-Group*		get_tracking_group_by_process(const std::wstring& process_name); // @TODO should return a list
+Group*		get_tracking_group_by_id(uint32_t id); // nullptr if the group was deleted
+// Push an execution in the pending executions of a group, the view thread merges it
+// termination_time is the date its end was seen by the capture (Windows ticks), see capture_lag.h
+// @Warning Should be called with editing_groups_critical_section locked
+void		record_execution(uint32_t group_id, uint32_t process_name_id, const RunningEntry& entry, Execution_Resources resources, uint64_t termination_time);
+const Group_List* get_tracking_groups_by_process(std::wstring_view process_name); // nullptr if the process isn't tracked
 void		request_redraw();
 
+// Contended acquisitions are timed for the diagnostics window, the others only cost a TryEnterCriticalSection
+inline void enter_editing_groups_critical_section()
+{
+	if (TryEnterCriticalSection(&g_dear_time.editing_groups_critical_section))
+		return;
+
+	Diagnostic_Scope wait(Diagnostic_Series::groups_lock_wait);
+	EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+}
+
 inline void request_redraw()
 {
+	InterlockedIncrement(&g_dear_time.nb_redraw_requests);
+
 	// @Warning
 	// Doing a Or bitwise operation always give a value at least equals to min_nb_redraws
 	// So if nb_requested_redraws = 0xffffffff it stay at 0xffffffff (permanent redraw value)
-	InterlockedOr(g_dear_time.nb_requested_redraws, min_nb_redraws);
+	// The main loop only waits after having seen 0, so the event is only needed on that transition.
+	if (InterlockedOr(g_dear_time.nb_requested_redraws, min_nb_redraws) == 0)
+		SetEvent(g_dear_time.redraw_event);
 }
 
 inline void start_permanent_redraw()
@@ -144,3 +156,7 @@ std::string				delete_group(const std::string& name); // Name of following group
 Rename_Errors			rename_group(const std::string& name, const std::string& new_name);
 void					get_processes_string(const std::string& group_name, char* buffer, size_t buffer_size);
 Update_Processes_Errors udpate_processes(const std::string& group_name, const std::string& processes_string, size_t processes_string_maximum_length);
+void					get_command_line_predicates_string(const std::string& group_name, char* buffer, size_t buffer_size);
+Update_Processes_Errors update_command_line_predicates(const std::string& group_name, const std::string& predicates_string, size_t predicates_string_maximum_length);
+void					update_freeze_detection(const std::string& group_name, uint32_t cpu_threshold_percent, uint32_t minimum_duration_ms);
+void					update_track_process_tree(const std::string& group_name, bool track_process_tree);
@@ -0,0 +1,178 @@
+#include "capture_lag.h"
+
+#include "time.h"
+
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <cassert>
+#include <cstdio>
+
+static_assert(std::has_single_bit(capture_lag_sub_buckets), "capture_lag_sub_buckets should be a power of 2");
+
+constexpr int capture_lag_sub_bucket_bits = std::countr_zero(capture_lag_sub_buckets);
+
+static std::atomic<uint64_t> capture_lag_histograms[(size_t)Capture_Stage::count][capture_lag_nb_buckets];
+
+// Values under capture_lag_sub_buckets have their own bucket, the others are split in capture_lag_sub_buckets
+// per power of 2
+static size_t get_capture_lag_bucket(uint64_t latency)
+{
+	if (latency < capture_lag_sub_buckets)
+		return (size_t)latency;
+
+	int shift = std::bit_width(latency) - 1 - capture_lag_sub_bucket_bits;
+
+	return capture_lag_sub_buckets * (1 + shift) + (size_t)((latency >> shift) - capture_lag_sub_buckets);
+}
+
+static uint64_t get_capture_lag_bucket_lower_bound(size_t bucket)
+{
+	if (bucket < capture_lag_sub_buckets)
+		return bucket;
+
+	size_t shift = bucket / capture_lag_sub_buckets - 1;
+
+	return (capture_lag_sub_buckets + bucket % capture_lag_sub_buckets) << shift;
+}
+
+static uint64_t get_capture_lag_bucket_upper_bound(size_t bucket)
+{
+	if (bucket < capture_lag_sub_buckets)
+		return bucket;
+	return get_capture_lag_bucket_lower_bound(bucket) + ((1ull << (bucket / capture_lag_sub_buckets - 1)) - 1);
+}
+
+const char* get_capture_stage_label(Capture_Stage stage)
+{
+	constexpr const char* labels[] = { "Termination", "Push", "Merge", "Display", "End to end" };
+	static_assert(std::size(labels) == (size_t)Capture_Stage::count);
+
+	return labels[(size_t)stage];
+}
+
+void record_capture_latency(Capture_Stage stage, uint64_t from, uint64_t to)
+{
+	uint64_t latency = to > from ? to - from : 0;
+
+	capture_lag_histograms[(size_t)stage][get_capture_lag_bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t get_nb_capture_latencies(Capture_Stage stage)
+{
+	uint64_t nb_latencies = 0;
+
+	for (const std::atomic<uint64_t>& count : capture_lag_histograms[(size_t)stage])
+		nb_latencies += count.load(std::memory_order_relaxed);
+	return nb_latencies;
+}
+
+void reset_capture_lag_histograms()
+{
+	for (auto& histogram : capture_lag_histograms)
+	{
+		for (std::atomic<uint64_t>& count : histogram)
+			count.store(0, std::memory_order_relaxed);
+	}
+}
+
+uint64_t get_capture_latency_percentile(Capture_Stage stage, double percentile)
+{
+	uint64_t nb_latencies = get_nb_capture_latencies(stage);
+
+	if (nb_latencies == 0)
+		return 0;
+
+	// Latencies recorded since the count are ignored, the last non empty bucket is the fallback
+	uint64_t rank = (uint64_t)(percentile * (nb_latencies - 1)) + 1;
+	uint64_t nb_seen = 0;
+	size_t   last_bucket = 0;
+
+	for (size_t bucket = 0; bucket < capture_lag_nb_buckets; bucket++)
+	{
+		uint64_t count = capture_lag_histograms[(size_t)stage][bucket].load(std::memory_order_relaxed);
+
+		if (count == 0)
+			continue;
+		last_bucket = bucket;
+		nb_seen += count;
+		if (nb_seen >= rank)
+			break;
+	}
+	return get_capture_lag_bucket_upper_bound(last_bucket);
+}
+
+bool save_capture_lag_histograms(const std::filesystem::path& path)
+{
+	std::ofstream	file(path, std::ios::binary | std::ios::trunc);
+	char			line[128];
+
+	if (!file)
+		return false;
+
+	file << "stage,lower_us,upper_us,count\n";
+	for (size_t stage = 0; stage < (size_t)Capture_Stage::count; stage++)
+	{
+		for (size_t bucket = 0; bucket < capture_lag_nb_buckets; bucket++)
+		{
+			uint64_t count = capture_lag_histograms[stage][bucket].load(std::memory_order_relaxed);
+
+			if (count == 0)
+				continue;
+			snprintf(line, sizeof(line), "%s,%.1f,%.1f,%llu\n", get_capture_stage_label((Capture_Stage)stage),
+				get_capture_lag_bucket_lower_bound(bucket) / 10.0, (get_capture_lag_bucket_upper_bound(bucket) + 1) / 10.0, (unsigned long long)count);
+			file << line;
+		}
+	}
+	file.close();
+	return (bool)file;
+}
+
+void test_capture_lag()
+{
+	// Buckets are contiguous and keep a relative precision of 1 / capture_lag_sub_buckets
+	assert(get_capture_lag_bucket(0) == 0 && get_capture_lag_bucket(7) == 7 && get_capture_lag_bucket(8) == 8 && get_capture_lag_bucket(16) == 16);
+	assert(get_capture_lag_bucket(UINT64_MAX) == capture_lag_nb_buckets - 1);
+	assert(get_capture_lag_bucket_upper_bound(capture_lag_nb_buckets - 1) == UINT64_MAX);
+	for (size_t bucket = 1; bucket < capture_lag_nb_buckets; bucket++)
+	{
+		uint64_t lower_bound = get_capture_lag_bucket_lower_bound(bucket);
+		uint64_t upper_bound = get_capture_lag_bucket_upper_bound(bucket);
+
+		assert(lower_bound == get_capture_lag_bucket_upper_bound(bucket - 1) + 1);
+		assert(get_capture_lag_bucket(lower_bound) == bucket && get_capture_lag_bucket(upper_bound) == bucket);
+		assert(upper_bound - lower_bound <= lower_bound / capture_lag_sub_buckets);
+	}
+
+	reset_capture_lag_histograms();
+
+	uint64_t now = get_current_windows_ticks();
+
+	for (uint64_t i = 1; i <= 100; i++)
+		record_capture_latency(Capture_Stage::display, now, now + i * 10'000); // 1 to 100 ms
+	record_capture_latency(Capture_Stage::display, now, now - 1); // Clock adjusted
+	assert(get_nb_capture_latencies(Capture_Stage::display) == 101);
+
+	uint64_t p50 = get_capture_latency_percentile(Capture_Stage::display, 0.5);
+	uint64_t p99 = get_capture_latency_percentile(Capture_Stage::display, 0.99);
+	assert(p50 >= 490'000 && p50 <= 500'000 * 9 / 8);
+	assert(p99 >= 990'000 && p99 <= 990'000 * 9 / 8);
+	assert(get_capture_latency_percentile(Capture_Stage::display, 0.0) == 0);
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "dear_time_test_capture_lag.csv";
+
+	assert(save_capture_lag_histograms(path));
+
+	std::ifstream	file(path);
+	std::string		content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	assert(content.starts_with("stage,lower_us,upper_us,count\n"));
+	assert(content.find("Display,0.0,0.1,1\n") != std::string::npos);
+
+	file.close();
+	std::filesystem::remove(path);
+	reset_capture_lag_histograms();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+// Lag of the capture: delays between the stages an execution goes through, from the end of its process
+// to the first frame that shows it. Latencies are counted in log scale histograms (8 buckets per power
+// of 2, so a bucket is at most 12.5% wide) for the whole session, recording one is a relaxed increment.
+// Dates are Windows ticks of the system clock (get_current_windows_ticks), as the dates given by the OS.
+
+enum class Capture_Stage : uint32_t
+{
+	termination,	// End of the process to its termination seen by the capture backend
+	push,			// Termination seen to execution pushed in pending executions (lock chain of the callback)
+	merge,			// Pushed to merged in merged_executions (wake up of the merging thread)
+	display,		// Merged to the first frame of its group drawn by the UI
+	end_to_end,		// End of the process to the first frame of its group drawn by the UI
+	count,
+};
+
+constexpr size_t capture_lag_sub_buckets = 8; // Per power of 2, power of 2
+constexpr size_t capture_lag_nb_buckets = capture_lag_sub_buckets + (64 - 3) * capture_lag_sub_buckets;
+
+// Dates of an execution kept until it is shown (the end of its process is RunningEntry::end_time)
+struct Execution_Capture
+{
+	uint64_t	end_time;
+	uint64_t	merge_time;
+};
+
+const char*	get_capture_stage_label(Capture_Stage stage);
+
+// A date to before from (clock adjusted by the system) counts as no latency (any thread)
+void		record_capture_latency(Capture_Stage stage, uint64_t from, uint64_t to);
+
+// Upper bound of the bucket of the percentile (0.0 to 1.0) of the latencies of a stage, in Windows
+// ticks, 0 without latency
+uint64_t	get_capture_latency_percentile(Capture_Stage stage, double percentile);
+uint64_t	get_nb_capture_latencies(Capture_Stage stage);
+void		reset_capture_lag_histograms();
+
+// CSV of the non empty buckets of all stages, bounds in microseconds
+bool		save_capture_lag_histograms(const std::filesystem::path& path);
+
+void test_capture_lag();
@@ -0,0 +1,390 @@
+#include "cgroup.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+
+#include <cassert>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Call function(key, value) for each "key value" line
+template<typename Function>
+static bool for_each_key_value(std::string_view content, Function function)
+{
+	while (!content.empty())
+	{
+		size_t				line_end = content.find('\n');
+		std::string_view	line = content.substr(0, line_end);
+
+		content.remove_prefix(line_end == std::string_view::npos ? content.size() : line_end + 1);
+
+		size_t separator = line.find(' ');
+		if (separator == std::string_view::npos)
+			continue;
+
+		std::string_view	value_string = line.substr(separator + 1);
+		uint64_t			value = 0;
+
+		if (std::from_chars(value_string.data(), value_string.data() + value_string.size(), value).ec != std::errc())
+			return false;
+		function(line.substr(0, separator), value);
+	}
+	return true;
+}
+
+bool parse_cgroup_populated(std::string_view events_content, bool& populated)
+{
+	bool found = false;
+
+	if (!for_each_key_value(events_content, [&](std::string_view key, uint64_t value) {
+		if (key == "populated")
+		{
+			populated = value != 0;
+			found = true;
+		}
+	}))
+		return false;
+	return found;
+}
+
+bool parse_cgroup_cpu_usage(std::string_view cpu_stat_content, Cgroup_Cpu_Usage& usage)
+{
+	bool found = false;
+
+	usage = {};
+	if (!for_each_key_value(cpu_stat_content, [&](std::string_view key, uint64_t value) {
+		if (key == "usage_usec")
+		{
+			usage.usage_usec = value;
+			found = true;
+		}
+		else if (key == "user_usec")
+			usage.user_usec = value;
+		else if (key == "system_usec")
+			usage.system_usec = value;
+	}))
+		return false;
+	return found;
+}
+
+#if defined(__linux__)
+
+// Interface files are small, they are read in a stack buffer without allocation
+static bool read_cgroup_file(const std::string& path, char* buffer, size_t buffer_size, std::string_view& content)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	ssize_t size = read(fd, buffer, buffer_size);
+	close(fd);
+	if (size < 0)
+		return false;
+
+	content = std::string_view(buffer, (size_t)size);
+	return true;
+}
+
+static bool read_cgroup_cpu_usage(const std::string& cpu_stat_path, Cgroup_Cpu_Usage& usage)
+{
+	char				buffer[4096];
+	std::string_view	content;
+
+	return read_cgroup_file(cpu_stat_path, buffer, sizeof(buffer), content) && parse_cgroup_cpu_usage(content, usage);
+}
+
+bool Cgroup_Tracker::initialize()
+{
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	return inotify_fd >= 0;
+}
+
+void Cgroup_Tracker::terminate()
+{
+	if (inotify_fd >= 0)
+		close(inotify_fd);
+	inotify_fd = -1;
+	cgroups.clear();
+}
+
+// Last component of the path of a cgroup, the name of its directory in its parent
+static std::string_view get_cgroup_name(std::string_view path)
+{
+	size_t separator = path.rfind('/');
+
+	return separator == std::string_view::npos ? path : path.substr(separator + 1);
+}
+
+bool Cgroup_Tracker::arm(Watched_Cgroup& cgroup)
+{
+	cgroup.watch = inotify_add_watch(inotify_fd, cgroup.events_path.c_str(), IN_MODIFY);
+	if (cgroup.watch < 0 && cgroup.parent_watch < 0)
+	{
+		cgroup.parent_watch = inotify_add_watch(inotify_fd, cgroup.parent_path.c_str(), IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+
+		// It can have been created before its parent was watched
+		cgroup.watch = inotify_add_watch(inotify_fd, cgroup.events_path.c_str(), IN_MODIFY);
+	}
+	if (cgroup.watch < 0)
+		return false;
+
+	release_parent_watch(cgroup);
+	return true;
+}
+
+void Cgroup_Tracker::release_parent_watch(Watched_Cgroup& cgroup)
+{
+	if (cgroup.parent_watch < 0)
+		return;
+
+	// Cgroups with the same parent share its watch descriptor
+	int parent_watch = cgroup.parent_watch;
+
+	cgroup.parent_watch = -1;
+	if (std::none_of(cgroups.begin(), cgroups.end(), [parent_watch](const Watched_Cgroup& other) { return other.parent_watch == parent_watch; }))
+		inotify_rm_watch(inotify_fd, parent_watch);
+}
+
+bool Cgroup_Tracker::watch(uint32_t group_id, const std::string& path)
+{
+	assert(inotify_fd >= 0);
+
+	unwatch(group_id);
+
+	Watched_Cgroup	cgroup = {};
+	size_t			separator = path.rfind('/');
+
+	cgroup.group_id = group_id;
+	cgroup.path = path;
+	cgroup.parent_path = separator == std::string::npos ? "." : separator == 0 ? "/" : path.substr(0, separator);
+	cgroup.events_path = path + "/cgroup.events";
+	cgroup.cpu_stat_path = path + "/cpu.stat";
+	cgroup.watch = -1;
+	cgroup.parent_watch = -1;
+
+	bool				is_armed = arm(cgroup);
+	char				buffer[256];
+	std::string_view	content;
+
+	if (is_armed && read_cgroup_file(cgroup.events_path, buffer, sizeof(buffer), content) && parse_cgroup_populated(content, cgroup.populated) && cgroup.populated)
+	{
+		cgroup.start_time = get_current_windows_ticks();
+		read_cgroup_cpu_usage(cgroup.cpu_stat_path, cgroup.start_usage);
+	}
+
+	cgroups.push_back(std::move(cgroup));
+	return is_armed;
+}
+
+void Cgroup_Tracker::unwatch(uint32_t group_id)
+{
+	auto it = std::find_if(cgroups.begin(), cgroups.end(), [group_id](const Watched_Cgroup& cgroup) { return cgroup.group_id == group_id; });
+
+	if (it == cgroups.end())
+		return;
+
+	Watched_Cgroup cgroup = std::move(*it);
+
+	cgroups.erase(it);
+	if (cgroup.watch >= 0)
+		inotify_rm_watch(inotify_fd, cgroup.watch);
+	release_parent_watch(cgroup);
+}
+
+void Cgroup_Tracker::update(Watched_Cgroup& cgroup, bool is_removed, std::vector<Cgroup_Activity>& ended_activities)
+{
+	char				buffer[256];
+	std::string_view	content;
+	bool				populated = false;
+
+	if (!is_removed && (!read_cgroup_file(cgroup.events_path, buffer, sizeof(buffer), content) || !parse_cgroup_populated(content, populated)))
+		return;
+
+	if (populated == cgroup.populated)
+		return;
+
+	uint64_t			now = get_current_windows_ticks();
+	Cgroup_Cpu_Usage	usage = cgroup.start_usage;
+
+	// cpu.stat is cumulative for the life of the cgroup, an activity gets the difference. A removed
+	// cgroup can't be read anymore, its last activity has no CPU time.
+	if (!is_removed)
+		read_cgroup_cpu_usage(cgroup.cpu_stat_path, usage);
+
+	if (populated)
+		cgroup.start_usage = usage;
+	else
+	{
+		Cgroup_Activity activity;
+
+		activity.group_id = cgroup.group_id;
+		activity.start_time = cgroup.start_time;
+		activity.end_time = now;
+		activity.user_time_ms = (uint32_t)((usage.user_usec - cgroup.start_usage.user_usec) / 1000);
+		activity.kernel_time_ms = (uint32_t)((usage.system_usec - cgroup.start_usage.system_usec) / 1000);
+		ended_activities.push_back(activity);
+	}
+	cgroup.populated = populated;
+	cgroup.start_time = now;
+}
+
+bool Cgroup_Tracker::wait(int timeout_ms, std::vector<Cgroup_Activity>& ended_activities)
+{
+	bool has_changes = false;
+
+	// Cgroups whose parent doesn't exist either can't be notified
+	for (Watched_Cgroup& cgroup : cgroups)
+	{
+		if (cgroup.watch < 0 && cgroup.parent_watch < 0 && arm(cgroup))
+		{
+			update(cgroup, false, ended_activities);
+			has_changes = true;
+		}
+	}
+
+	pollfd poll_fd = { inotify_fd, POLLIN, 0 };
+
+	if (poll(&poll_fd, 1, has_changes ? 0 : timeout_ms) <= 0)
+		return has_changes;
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t size;
+
+	while ((size = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (char* event_pointer = buffer; event_pointer < buffer + size; )
+		{
+			const inotify_event* event = (const inotify_event*)event_pointer;
+
+			event_pointer += sizeof(inotify_event) + event->len;
+
+			// Many events of a cgroup in the same read only cost a read of cgroup.events each
+			for (Watched_Cgroup& cgroup : cgroups)
+			{
+				if (cgroup.watch == event->wd)
+				{
+					update(cgroup, (event->mask & IN_IGNORED) != 0, ended_activities);
+
+					// Removed, it can already have been created again
+					if (event->mask & IN_IGNORED)
+					{
+						cgroup.watch = -1;
+						if (arm(cgroup))
+							update(cgroup, false, ended_activities);
+					}
+					break;
+				}
+			}
+
+			// Creation of cgroups in a watched parent, or removal of the parent
+			for (Watched_Cgroup& cgroup : cgroups)
+			{
+				if (cgroup.parent_watch != event->wd)
+					continue;
+
+				if (event->mask & IN_IGNORED)
+					cgroup.parent_watch = -1;
+				else if (event->len && get_cgroup_name(cgroup.path) == event->name && arm(cgroup))
+					update(cgroup, false, ended_activities);
+			}
+		}
+	}
+	return true;
+}
+
+#endif
+
+void test_cgroup()
+{
+	bool				populated = false;
+	Cgroup_Cpu_Usage	usage;
+
+	assert(parse_cgroup_populated("populated 1\nfrozen 0\n", populated) && populated);
+	assert(parse_cgroup_populated("frozen 0\npopulated 0", populated) && !populated);
+	assert(!parse_cgroup_populated("frozen 0\n", populated));
+	assert(parse_cgroup_cpu_usage("usage_usec 3500\nuser_usec 2000\nsystem_usec 1500\nnr_periods 0\n", usage));
+	assert(usage.usage_usec == 3500 && usage.user_usec == 2000 && usage.system_usec == 1500);
+	assert(!parse_cgroup_cpu_usage("usage_usec abc\n", usage));
+
+#if defined(__linux__)
+	// The tracker only needs the two files, a temporary directory mimics a cgroup
+	char directory[] = "/tmp/dear_time_cgroup_XXXXXX";
+	assert(mkdtemp(directory));
+
+	std::string path = directory;
+	auto write_file = [](const std::string& file_path, std::string_view content) {
+		int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		assert(fd >= 0);
+		ssize_t written = write(fd, content.data(), content.size());
+		assert(written == (ssize_t)content.size());
+		close(fd);
+	};
+	auto remove_cgroup = [](const std::string& cgroup_path) {
+		unlink((cgroup_path + "/cgroup.events").c_str());
+		unlink((cgroup_path + "/cpu.stat").c_str());
+		rmdir(cgroup_path.c_str());
+	};
+	// The kernel creates a cgroup with its files at once, they are written before the directory is moved in place
+	auto create_cgroup = [&](const std::string& cgroup_path, std::string_view events_content) {
+		char staging_directory[] = "/tmp/dear_time_cgroup_XXXXXX";
+		assert(mkdtemp(staging_directory));
+		write_file(std::string(staging_directory) + "/cgroup.events", events_content);
+		write_file(std::string(staging_directory) + "/cpu.stat", "usage_usec 0\nuser_usec 0\nsystem_usec 0\n");
+		int result = rename(staging_directory, cgroup_path.c_str());
+		assert(result == 0);
+	};
+
+	write_file(path + "/cgroup.events", "populated 0\nfrozen 0\n");
+	write_file(path + "/cpu.stat", "usage_usec 1000\nuser_usec 800\nsystem_usec 200\n");
+
+	Cgroup_Tracker					tracker;
+	std::vector<Cgroup_Activity>	activities;
+
+	assert(tracker.initialize());
+	assert(tracker.watch(7, path));
+
+	write_file(path + "/cgroup.events", "populated 1\nfrozen 0\n");
+	assert(tracker.wait(1000, activities) && activities.empty());
+
+	write_file(path + "/cpu.stat", "usage_usec 9000\nuser_usec 5800\nsystem_usec 3200\n");
+	write_file(path + "/cgroup.events", "populated 0\nfrozen 0\n");
+	assert(tracker.wait(1000, activities));
+	assert(activities.size() == 1);
+	assert(activities[0].group_id == 7 && activities[0].start_time <= activities[0].end_time);
+	assert(activities[0].user_time_ms == 5 && activities[0].kernel_time_ms == 3);
+
+	// Removed while populated (a transient scope), its activity ends without CPU time
+	write_file(path + "/cgroup.events", "populated 1\nfrozen 0\n");
+	assert(tracker.wait(1000, activities) && activities.size() == 1);
+	remove_cgroup(path);
+	assert(tracker.wait(1000, activities));
+	assert(activities.size() == 2 && activities[1].user_time_ms == 0 && activities[1].kernel_time_ms == 0);
+	assert(tracker.cgroups[0].watch < 0 && tracker.cgroups[0].parent_watch >= 0);
+
+	// Created again, it is watched from its creation
+	create_cgroup(path, "populated 1\nfrozen 0\n");
+	assert(tracker.wait(1000, activities) && activities.size() == 2);
+	assert(tracker.cgroups[0].watch >= 0 && tracker.cgroups[0].parent_watch < 0 && tracker.cgroups[0].populated);
+	write_file(path + "/cgroup.events", "populated 0\nfrozen 0\n");
+	assert(tracker.wait(1000, activities) && activities.size() == 3 && activities[2].group_id == 7);
+
+	// Not created yet when it is watched
+	std::string later_path = path + "_later";
+
+	assert(!tracker.watch(8, later_path));
+	create_cgroup(later_path, "populated 1\nfrozen 0\n");
+	assert(tracker.wait(1000, activities));
+	assert(tracker.cgroups[1].group_id == 8 && tracker.cgroups[1].watch >= 0 && tracker.cgroups[1].populated);
+
+	tracker.terminate();
+	remove_cgroup(path);
+	remove_cgroup(later_path);
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "time.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+// Tracking of a group bound to a cgroup (v2) instead of process names, for builds running in systemd
+// scopes or containers. An activity is a period where the cgroup contains processes, given by the
+// "populated" transitions of cgroup.events, its CPU time comes from cpu.stat. There is no per process
+// work at all, whatever the number of processes started inside the cgroup.
+
+struct Cgroup_Cpu_Usage
+{
+	uint64_t	usage_usec = 0;
+	uint64_t	user_usec = 0;
+	uint64_t	system_usec = 0;
+};
+
+struct Cgroup_Activity
+{
+	uint32_t	group_id;
+	uint64_t	start_time; // Windows ticks, as RunningEntry
+	uint64_t	end_time;
+	uint32_t	user_time_ms;
+	uint32_t	kernel_time_ms;
+};
+
+// Parsers of the cgroup interface files (flat "key value" lines), they are portable
+bool parse_cgroup_populated(std::string_view events_content, bool& populated);
+bool parse_cgroup_cpu_usage(std::string_view cpu_stat_content, Cgroup_Cpu_Usage& usage);
+
+#if defined(__linux__)
+
+// Watch many cgroups with a single inotify descriptor, the kernel signals a modification of
+// cgroup.events on each transition so there is no polling of the files.
+// A cgroup can be removed and created again (a transient systemd scope), or not exist yet when it is
+// watched: its parent directory is watched for its creation instead, and wait retries cgroups whose
+// parent doesn't exist either.
+// @Warning Not thread safe, should be used from the thread that captures
+struct Cgroup_Tracker
+{
+	struct Watched_Cgroup
+	{
+		uint32_t			group_id;
+		std::string			path; // Directory of the cgroup, like /sys/fs/cgroup/system.slice/build.scope
+		std::string			parent_path;
+		std::string			events_path;
+		std::string			cpu_stat_path;
+		int					watch; // Of cgroup.events, -1 while the cgroup doesn't exist
+		int					parent_watch; // Of parent_path (IN_CREATE) while the cgroup doesn't exist, else -1
+		bool				populated;
+		uint64_t			start_time; // Of the current activity
+		Cgroup_Cpu_Usage	start_usage;
+	};
+
+	int							inotify_fd = -1;
+	std::vector<Watched_Cgroup>	cgroups;
+
+	bool	initialize();
+	void	terminate();
+
+	// A cgroup already populated starts an activity now, its real start is unknown.
+	// Return false if the cgroup doesn't exist yet, it is watched as soon as it is created.
+	bool	watch(uint32_t group_id, const std::string& path);
+	void	unwatch(uint32_t group_id);
+
+	// Wait at most timeout_ms (-1 for infinite) for transitions, ended activities are appended.
+	// inotify_fd can also be given to another poll loop, then call wait with a timeout of 0.
+	// @Warning Cgroups without parent directory are only retried by calls of wait with a finite timeout
+	bool	wait(int timeout_ms, std::vector<Cgroup_Activity>& ended_activities);
+
+	void	update(Watched_Cgroup& cgroup, bool is_removed, std::vector<Cgroup_Activity>& ended_activities);
+
+	// Watch cgroup.events, or the parent directory if the cgroup doesn't exist, true if the cgroup exists
+	bool	arm(Watched_Cgroup& cgroup);
+	void	release_parent_watch(Watched_Cgroup& cgroup);
+};
+
+#endif
+
+void test_cgroup();
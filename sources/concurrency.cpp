@@ -0,0 +1,221 @@
+#include "concurrency.h"
+
+#include "intervals.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include <cassert>
+
+void Concurrency_Timeline::reset()
+{
+	step_times.clear();
+	step_counts.clear();
+	maximum_concurrency = 0;
+	exclusive_times.clear();
+	sweep = Sweep_State();
+	checkpoints.clear();
+	drained_running.clear();
+}
+
+void Concurrency_Timeline::push_step(uint64_t time, uint32_t count)
+{
+	if (!step_times.empty() && step_times.back() == time)
+		step_counts.back() = count;
+	else
+	{
+		step_times.push_back(time);
+		step_counts.push_back(count);
+	}
+}
+
+void Concurrency_Timeline::advance(uint64_t time, std::vector<Running_Execution>& heap, double& shared, uint64_t& now, std::vector<uint64_t>& exclusive)
+{
+	// Terminate executions ending before time
+	while (!heap.empty() && heap.front().end_time <= time)
+	{
+		Running_Execution execution = heap.front();
+
+		shared += (double)(execution.end_time - now) / heap.size();
+		now = execution.end_time;
+
+		std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+		heap.pop_back();
+
+		if (execution.executable_index >= exclusive.size())
+			exclusive.resize(execution.executable_index + 1, 0);
+		exclusive[execution.executable_index] += (uint64_t)(shared - execution.shared_time_at_start + 0.5);
+		push_step(now, (uint32_t)heap.size());
+	}
+
+	if (!heap.empty())
+		shared += (double)(time - now) / heap.size();
+	now = time;
+}
+
+void Concurrency_Timeline::restore(const Sweep_State& state)
+{
+	sweep = state;
+	step_times.resize(sweep.nb_steps);
+	step_counts.resize(sweep.nb_steps);
+	if (sweep.nb_steps)
+		step_counts.back() = sweep.last_step_count;
+}
+
+void Concurrency_Timeline::rewind(size_t index)
+{
+	if (index >= sweep.nb_processed)
+		return;
+
+	while (!checkpoints.empty() && checkpoints.back().nb_processed > index)
+		checkpoints.pop_back();
+	if (checkpoints.empty())
+		reset();
+	else
+		restore(checkpoints.back());
+}
+
+void Concurrency_Timeline::update(const std::vector<Execution_Resources>& executions)
+{
+	// Steps drained by the previous update are replaced
+	step_times.resize(sweep.nb_steps);
+	step_counts.resize(sweep.nb_steps);
+	if (sweep.nb_steps)
+		step_counts.back() = sweep.last_step_count;
+
+	for (; sweep.nb_processed < executions.size(); sweep.nb_processed++)
+	{
+		const Execution_Resources& execution = executions[sweep.nb_processed];
+
+		if (sweep.nb_processed % concurrency_checkpoint_interval == 0 && sweep.nb_processed
+			&& (checkpoints.empty() || checkpoints.back().nb_processed < sweep.nb_processed))
+		{
+			sweep.nb_steps = step_times.size();
+			sweep.last_step_count = step_counts.back();
+			checkpoints.push_back(sweep);
+		}
+
+		assert(execution.start_time >= sweep.current_time); // Sorted, otherwise the timeline should be rewound
+		advance(execution.start_time, sweep.running, sweep.shared_time, sweep.current_time, sweep.exclusive_times);
+
+		sweep.running.push_back({ std::max(execution.end_time, execution.start_time), sweep.shared_time, execution.executable_index });
+		std::push_heap(sweep.running.begin(), sweep.running.end(), std::greater<>());
+
+		push_step(sweep.current_time, (uint32_t)sweep.running.size());
+		sweep.maximum_concurrency = std::max(sweep.maximum_concurrency, (uint32_t)sweep.running.size());
+	}
+	sweep.nb_steps = step_times.size();
+	sweep.last_step_count = sweep.nb_steps ? step_counts.back() : 0;
+
+	// Ends of the running executions, the sweep continues from the last start with the next update
+	double		shared = sweep.shared_time;
+	uint64_t	now = sweep.current_time;
+
+	drained_running = sweep.running;
+	exclusive_times = sweep.exclusive_times;
+	advance(UINT64_MAX, drained_running, shared, now, exclusive_times);
+	maximum_concurrency = sweep.maximum_concurrency;
+}
+
+void test_concurrency_timeline()
+{
+	Concurrency_Timeline			timeline;
+	std::vector<Execution_Resources> executions;
+
+	// Inserted at its place by start time, as merge_pending_executions does, return its index
+	auto add_execution = [&](uint64_t start_time, uint64_t end_time, uint32_t executable_index) -> size_t {
+		Execution_Resources execution = {};
+
+		execution.start_time = start_time;
+		execution.end_time = end_time;
+		execution.executable_index = executable_index;
+
+		auto it = std::upper_bound(executions.begin(), executions.end(), start_time,
+			[](uint64_t start_time, const Execution_Resources& other) { return start_time < other.start_time; });
+		size_t index = (size_t)std::distance(executions.begin(), it);
+
+		timeline.rewind(index);
+		executions.insert(it, execution);
+		return index;
+	};
+
+	auto is_fresh = [&]() {
+		Concurrency_Timeline fresh_timeline;
+
+		fresh_timeline.update(executions);
+		return timeline.step_times == fresh_timeline.step_times && timeline.step_counts == fresh_timeline.step_counts
+			&& timeline.maximum_concurrency == fresh_timeline.maximum_concurrency && timeline.exclusive_times == fresh_timeline.exclusive_times;
+	};
+
+	// 0: [0, 30] alone then shared with 1 on [12, 24] and with 1 and 2 on [18, 24]
+	add_execution(0, 30, 0);
+	add_execution(12, 24, 1);
+	timeline.update(executions);
+	assert(timeline.maximum_concurrency == 2);
+	add_execution(18, 24, 2);
+	add_execution(60, 66, 0);
+	timeline.update(executions);
+
+	assert(timeline.step_times == std::vector<uint64_t>({ 0, 12, 18, 24, 30, 60, 66 }));
+	assert(timeline.step_counts == std::vector<uint32_t>({ 1, 2, 3, 1, 0, 1, 0 }));
+	assert(timeline.maximum_concurrency == 3);
+
+	// Executable 0: 12 + 6 / 2 + 6 / 3 + 6 + 6 = 29, 1: 6 / 2 + 6 / 3 = 5, 2: 6 / 3 = 2
+	assert(timeline.exclusive_times == std::vector<uint64_t>({ 29, 5, 2 }));
+
+	// An update without new execution gives the same tail
+	timeline.update(executions);
+	assert(timeline.step_counts.size() == 7 && timeline.exclusive_times == std::vector<uint64_t>({ 29, 5, 2 }));
+
+	// Executions recorded when they end, in an other order than they started like in a parallel build.
+	// A late execution only rewinds the sweep to the checkpoint before it.
+	constexpr uint64_t	second = 10'000'000;
+	uint64_t			random = 1;
+
+	for (uint64_t build = 0; build < 4; build++)
+	{
+		std::vector<Execution_Resources>	build_executions;
+		uint64_t							start_time = (1 + build) * 3600 * second;
+
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			Execution_Resources execution = {};
+
+			random = random * 6364136223846793005ull + 1442695040888963407ull;
+			start_time += (random >> 33) % (2 * second);
+			execution.start_time = start_time;
+			execution.end_time = start_time + (random >> 40) % (60 * second);
+			execution.executable_index = i % 3;
+			build_executions.push_back(execution);
+		}
+		std::sort(build_executions.begin(), build_executions.end(),
+			[](const Execution_Resources& a, const Execution_Resources& b) { return a.end_time < b.end_time; });
+
+		for (size_t i = 0; i < build_executions.size(); i++)
+		{
+			const Execution_Resources&	execution = build_executions[i];
+			size_t						nb_processed = timeline.sweep.nb_processed;
+			size_t						index = add_execution(execution.start_time, execution.end_time, execution.executable_index);
+
+			assert(timeline.sweep.nb_processed == nb_processed || timeline.sweep.nb_processed + concurrency_checkpoint_interval > index);
+			if (i % 50 == 0)
+				timeline.update(executions);
+		}
+		timeline.update(executions);
+		assert(is_fresh());
+	}
+
+	// A long execution (an IDE) recorded hours after its start
+	size_t index = add_execution(2 * 3600 * second + 30 * second, 5 * 3600 * second, 1);
+
+	assert(index > 1000 && timeline.sweep.nb_processed + concurrency_checkpoint_interval > index);
+	timeline.update(executions);
+	assert(is_fresh() && timeline.maximum_concurrency >= 2);
+
+	// Executions before the first checkpoint sweep again from the start
+	add_execution(100, 200, 0);
+	assert(timeline.sweep.nb_processed == 0);
+	timeline.update(executions);
+	assert(is_fresh());
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+struct Execution_Resources;
+
+// Sweep line over the executions of a group (not merged), gives:
+//  - the number of executions running at once over time (steps)
+//  - the wall time of each executable where time shared by N running executions is split in N
+//
+// Executions should be sorted by start time, each start is swept in O(log n). They are recorded when they
+// end, so overlapping ones arrive out of order: the sweep state is saved every concurrency_checkpoint_interval
+// starts, and an execution inserted before swept ones only rewinds the sweep to the checkpoint before it.
+// Ends of the executions still running after the last start are drained on a copy of the running ones, so
+// steps and exclusive times include them and queries read them in place.
+// The exclusive time of an execution is A(end) - A(start) where A(t) is the integral of 1 / concurrency,
+// so the attribution doesn't need to visit all running executions at each event.
+constexpr size_t concurrency_checkpoint_interval = 256; // In swept starts
+
+struct Concurrency_Timeline
+{
+	struct Running_Execution
+	{
+		uint64_t	end_time;
+		double		shared_time_at_start; // A(start)
+		uint32_t	executable_index;
+
+		bool operator>(const Running_Execution& other) const { return end_time > other.end_time; }
+	};
+
+	// Sweep state after nb_processed starts
+	struct Sweep_State
+	{
+		size_t							nb_processed = 0;
+		size_t							nb_steps = 0;
+		uint32_t						last_step_count = 0; // The next starts or ends can change it
+		uint32_t						maximum_concurrency = 0;
+		uint64_t						current_time = 0;
+		double							shared_time = 0.0; // A(current_time)
+		std::vector<Running_Execution>	running; // Min heap on end_time
+		std::vector<uint64_t>			exclusive_times; // Of ended executions
+	};
+
+	// At step_times[i] the concurrency becomes step_counts[i], the ones after sweep.nb_steps are drained
+	std::vector<uint64_t>	step_times;
+	std::vector<uint32_t>	step_counts;
+	uint32_t				maximum_concurrency = 0;
+
+	std::vector<uint64_t>	exclusive_times; // Per executable index, in Windows ticks
+
+	Sweep_State					sweep;
+	std::vector<Sweep_State>	checkpoints; // Every concurrency_checkpoint_interval starts
+	std::vector<Running_Execution>	drained_running; // Scratch of the drain
+
+	void reset();
+
+	// Executions were inserted at index, the sweep is resumed from the last checkpoint before it
+	void rewind(size_t index);
+	void update(const std::vector<Execution_Resources>& executions);
+
+private:
+	void advance(uint64_t time, std::vector<Running_Execution>& heap, double& shared, uint64_t& now, std::vector<uint64_t>& exclusive);
+	void push_step(uint64_t time, uint32_t count);
+	void restore(const Sweep_State& state);
+};
+
+void test_concurrency_timeline();
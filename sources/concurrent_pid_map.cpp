@@ -0,0 +1,136 @@
+#include "concurrent_pid_map.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cassert>
+
+void test_concurrent_pid_map()
+{
+	// Contention smoke test (run at each debug startup, kept short, benchmarks/concurrent_pid_map.cpp is the
+	// stress test): every thread inserts its own pids (multiples of 4 like on Windows) while an other thread
+	// takes them, as the WMI thread and the thread pool callbacks do.
+	constexpr uint32_t nb_threads = 4;
+	constexpr uint32_t nb_pids_per_thread = 1'000;
+
+	Concurrent_Pid_Map<uint64_t>	map;
+	std::atomic<uint64_t>			nb_taken = 0;
+	std::atomic<uint64_t>			taken_checksum = 0;
+	std::vector<std::thread>		threads;
+
+	for (uint32_t thread_index = 0; thread_index < nb_threads; thread_index++)
+	{
+		threads.emplace_back([&, thread_index]() {
+			uint32_t victim_index = (thread_index + 1) % nb_threads;
+
+			for (uint32_t i = 0; i < nb_pids_per_thread; i++)
+			{
+				uint32_t pid = (i * nb_threads + thread_index) * 4;
+				map.insert(pid, (uint64_t)pid + 1);
+
+				// Take an entry inserted by an other thread, it may not be there yet
+				uint32_t	victim_pid = (i * nb_threads + victim_index) * 4;
+				uint64_t	value;
+				if (map.take(victim_pid, value))
+				{
+					assert(value == (uint64_t)victim_pid + 1);
+					nb_taken++;
+					taken_checksum += value;
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// Take what remains
+	for (uint32_t pid_index = 0; pid_index < nb_threads * nb_pids_per_thread; pid_index++)
+	{
+		uint64_t value;
+		if (map.take(pid_index * 4, value))
+		{
+			nb_taken++;
+			taken_checksum += value;
+		}
+	}
+
+	uint64_t expected_checksum = 0;
+	for (uint64_t pid_index = 0; pid_index < nb_threads * nb_pids_per_thread; pid_index++)
+		expected_checksum += pid_index * 4 + 1;
+
+	assert(nb_taken == nb_threads * nb_pids_per_thread);
+	assert(taken_checksum == expected_checksum);
+	assert(map.size() == 0);
+
+	// Replace on pid reuse
+	map.insert(4, 1);
+	map.insert(4, 2);
+	uint64_t value = 0;
+	assert(map.take(4, value) && value == 2);
+	assert(!map.contains(4));
+
+	// Conditional erase (generation tags)
+	map.insert(8, 3);
+	assert(!map.erase_if(8, [](uint64_t generation) { return generation == 2; }));
+	assert(map.find(8, value) && value == 3);
+	assert(map.erase_if(8, [](uint64_t generation) { return generation == 3; }));
+	assert(!map.find(8, value));
+
+	// Rescans while terminations are in flight, as attach_process and process_termination_callback do under
+	// editing_groups_critical_section: an ended process is recorded by its record or attached again (a second
+	// wait that fires immediately), never both.
+	struct Test_Record
+	{
+		uint32_t nb_groups;
+	};
+
+	constexpr uint32_t nb_processes = 2'000;
+
+	Tracked_Processes<Test_Record>	tracked_processes;
+	std::vector<Test_Record>		records(nb_processes, Test_Record{ 1 });
+	std::vector<uint32_t>			nb_recorded(nb_processes, 0);
+	std::mutex						editing_lock;
+	std::atomic<bool>				all_terminated = false;
+
+	auto get_creation_time = [](uint32_t pid) { return 1000 + (uint64_t)pid; };
+
+	for (uint32_t process_index = 0; process_index < nb_processes; process_index++)
+		tracked_processes.insert(process_index * 4, &records[process_index]);
+
+	std::thread termination_thread([&]() {
+		for (uint32_t process_index = 0; process_index < nb_processes; process_index++)
+		{
+			uint32_t		pid = process_index * 4;
+			Test_Record*	record = nullptr;
+
+			std::lock_guard lock(editing_lock);
+			if (tracked_processes.terminate(pid, get_creation_time(pid), record))
+				nb_recorded[process_index] += record->nb_groups;
+		}
+		all_terminated = true;
+	});
+
+	while (!all_terminated)
+	{
+		for (uint32_t process_index = 0; process_index < nb_processes; process_index++)
+		{
+			uint32_t		pid = process_index * 4;
+			Test_Record*	record = nullptr;
+
+			std::lock_guard lock(editing_lock);
+			if (tracked_processes.find(pid, record))
+				assert(record == &records[process_index]); // Its groups would be completed
+			else if (!tracked_processes.is_terminated(pid, get_creation_time(pid)))
+				nb_recorded[process_index]++;
+		}
+	}
+	termination_thread.join();
+
+	for (uint32_t process_index = 0; process_index < nb_processes; process_index++)
+		assert(nb_recorded[process_index] == 1);
+
+	// A new process with a reused pid is attached
+	assert(!tracked_processes.is_terminated(4, get_creation_time(4) + 1));
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "spin_lock.h"
+
+#include <mutex>
+#include <vector>
+
+#include <cstdint>
+
+// Map from process id to Value, usable concurrently from many threads without any external lock.
+// Entries are spread over shards by pid, each shard is an open addressing table (no allocation per
+// entry) protected by its own Spin_Lock and aligned on a cache line, so threads working on different
+// processes rarely contend.
+template<typename Value, size_t nb_shards = 64>
+class Concurrent_Pid_Map
+{
+	static_assert((nb_shards & (nb_shards - 1)) == 0, "nb_shards should be a power of 2");
+
+	static constexpr uint32_t empty_key = 0xffffffff;
+	static constexpr uint32_t erased_key = 0xfffffffe;
+	static constexpr size_t initial_capacity = 16; // Per shard, power of 2
+
+	struct Slot
+	{
+		uint32_t	key = empty_key;
+		Value		value;
+	};
+
+	struct alignas(64) Shard
+	{
+		Spin_Lock			lock;
+		std::vector<Slot>	slots;
+		size_t				nb_entries = 0;
+		size_t				nb_used_slots = 0; // Entries + erased slots
+	};
+
+	Shard m_shards[nb_shards];
+
+	static size_t hash(uint32_t pid)
+	{
+		// Windows pids are multiples of 4, mix bits before taking the low ones
+		uint64_t h = (uint64_t)pid * 0x9E3779B97F4A7C15ull;
+		return (size_t)(h >> 32);
+	}
+
+	Shard& get_shard(uint32_t pid, size_t& h)
+	{
+		h = hash(pid);
+		return m_shards[h & (nb_shards - 1)];
+	}
+
+	static Slot* find_slot(Shard& shard, uint32_t pid, size_t h)
+	{
+		if (shard.slots.empty())
+			return nullptr;
+
+		size_t mask = shard.slots.size() - 1;
+		for (size_t i = (h / nb_shards) & mask;; i = (i + 1) & mask)
+		{
+			if (shard.slots[i].key == pid)
+				return &shard.slots[i];
+			if (shard.slots[i].key == empty_key)
+				return nullptr;
+		}
+	}
+
+	static void rehash(Shard& shard, size_t capacity)
+	{
+		std::vector<Slot> old_slots = std::move(shard.slots);
+
+		shard.slots.assign(capacity, Slot());
+		shard.nb_used_slots = shard.nb_entries;
+		for (Slot& slot : old_slots)
+		{
+			if (slot.key == empty_key || slot.key == erased_key)
+				continue;
+
+			size_t mask = capacity - 1;
+			size_t i = (hash(slot.key) / nb_shards) & mask;
+			while (shard.slots[i].key != empty_key)
+				i = (i + 1) & mask;
+			shard.slots[i] = std::move(slot);
+		}
+	}
+
+public:
+	// Insert or replace (pid reused after we missed the termination)
+	void insert(uint32_t pid, Value value)
+	{
+		size_t h;
+		Shard& shard = get_shard(pid, h);
+		std::lock_guard<Spin_Lock> guard(shard.lock);
+
+		if (Slot* slot = find_slot(shard, pid, h))
+		{
+			slot->value = std::move(value);
+			return;
+		}
+
+		// Keep the load factor (with erased slots) under 1/2, only grow when entries are over 1/4
+		if ((shard.nb_used_slots + 1) * 2 > shard.slots.size())
+		{
+			size_t capacity = shard.slots.empty() ? initial_capacity : shard.slots.size();
+
+			while (shard.nb_entries * 4 >= capacity)
+				capacity *= 2;
+			rehash(shard, capacity);
+		}
+
+		size_t mask = shard.slots.size() - 1;
+		size_t i = (h / nb_shards) & mask;
+		while (shard.slots[i].key != empty_key && shard.slots[i].key != erased_key)
+			i = (i + 1) & mask;
+
+		if (shard.slots[i].key == empty_key)
+			shard.nb_used_slots++;
+		shard.slots[i].key = pid;
+		shard.slots[i].value = std::move(value);
+		shard.nb_entries++;
+	}
+
+	// Find and erase, return false if the pid isn't in the map
+	bool take(uint32_t pid, Value& value)
+	{
+		size_t h;
+		Shard& shard = get_shard(pid, h);
+		std::lock_guard<Spin_Lock> guard(shard.lock);
+
+		Slot* slot = find_slot(shard, pid, h);
+		if (!slot)
+			return false;
+
+		value = std::move(slot->value);
+		slot->key = erased_key;
+		slot->value = Value();
+		shard.nb_entries--;
+		return true;
+	}
+
+	bool find(uint32_t pid, Value& value)
+	{
+		size_t h;
+		Shard& shard = get_shard(pid, h);
+		std::lock_guard<Spin_Lock> guard(shard.lock);
+
+		Slot* slot = find_slot(shard, pid, h);
+		if (!slot)
+			return false;
+
+		value = slot->value;
+		return true;
+	}
+
+	// Erase only if predicate(value) is true, to not erase an entry of a reused pid
+	template<typename Predicate>
+	bool erase_if(uint32_t pid, Predicate predicate)
+	{
+		size_t h;
+		Shard& shard = get_shard(pid, h);
+		std::lock_guard<Spin_Lock> guard(shard.lock);
+
+		Slot* slot = find_slot(shard, pid, h);
+		if (!slot || !predicate(slot->value))
+			return false;
+
+		slot->key = erased_key;
+		slot->value = Value();
+		shard.nb_entries--;
+		return true;
+	}
+
+	bool contains(uint32_t pid)
+	{
+		size_t h;
+		Shard& shard = get_shard(pid, h);
+		std::lock_guard<Spin_Lock> guard(shard.lock);
+
+		return find_slot(shard, pid, h) != nullptr;
+	}
+
+	// @Warning Approximative when other threads are modifying the map
+	size_t size()
+	{
+		size_t nb_entries = 0;
+
+		for (Shard& shard : m_shards)
+		{
+			std::lock_guard<Spin_Lock> guard(shard.lock);
+			nb_entries += shard.nb_entries;
+		}
+		return nb_entries;
+	}
+};
+
+// Records of the processes waited for, by pid. The termination callback takes a record while a rescan (or a
+// creation event) attaches the same process: both hold the same external lock so a record is either found and
+// completed or already terminated. A terminated process can still be opened while handles on it are open,
+// so the creation time of the last terminated process of each pid is kept to not wait for it a second time.
+// An entry is only replaced when its pid is reused, there are as many as pid values seen.
+template<typename Record>
+class Tracked_Processes
+{
+	Concurrent_Pid_Map<Record*>		m_records;
+	Concurrent_Pid_Map<uint64_t>	m_terminated_creation_times;
+
+public:
+	bool find(uint32_t pid, Record*& record) { return m_records.find(pid, record); }
+	void insert(uint32_t pid, Record* record) { m_records.insert(pid, record); }
+	bool take(uint32_t pid, Record*& record) { return m_records.take(pid, record); }
+
+	// Take the record of a process that ended, false if it wasn't tracked
+	// @Warning The lock of attaches should be held
+	bool terminate(uint32_t pid, uint64_t creation_time, Record*& record)
+	{
+		m_terminated_creation_times.insert(pid, creation_time);
+		return m_records.take(pid, record);
+	}
+
+	// True if the termination of this process (not an other one with the same pid) was already handled
+	bool is_terminated(uint32_t pid, uint64_t creation_time)
+	{
+		uint64_t terminated_creation_time;
+
+		return m_terminated_creation_times.find(pid, terminated_creation_time) && terminated_creation_time == creation_time;
+	}
+};
+
+void test_concurrent_pid_map();
@@ -0,0 +1,231 @@
+#include "cpu_sampler.h"
+
+#include "application.h"
+#include "trace.h"
+
+#include <algorithm>
+
+#include <cassert>
+
+constexpr size_t maximum_nb_watched_processes = 256;
+constexpr DWORD slow_sampling_period_ms = 250;
+constexpr DWORD fast_sampling_period_ms = 50; // When a process is over its threshold
+
+struct Watched_Process
+{
+	HANDLE		process_handle;
+	uint32_t	process_id;
+	uint32_t	group_id;
+	uint32_t	process_name_id;
+	uint32_t	cpu_threshold_percent;
+	uint32_t	minimum_duration_ms;
+
+	uint64_t	last_sample_time; // Windows ticks
+	uint64_t	last_cpu_time; // user + kernel, Windows ticks
+
+	uint64_t	over_threshold_since; // 0 when under the threshold
+	uint64_t	over_threshold_user_time;
+	uint64_t	over_threshold_kernel_time;
+	uint64_t	last_user_time;
+	uint64_t	last_kernel_time;
+};
+
+struct Freeze
+{
+	uint32_t			group_id;
+	uint32_t			process_name_id;
+	RunningEntry		entry;
+	Execution_Resources	resources;
+};
+
+// Fixed size storage, sampling never allocates
+static CRITICAL_SECTION	watched_processes_critical_section;
+static Watched_Process	watched_processes[maximum_nb_watched_processes];
+static size_t			nb_watched_processes = 0;
+
+static HANDLE	sampler_thread = NULL;
+static HANDLE	stop_event = NULL;
+static HANDLE	wake_event = NULL; // A process was added
+
+static uint64_t to_ticks(const FILETIME& file_time)
+{
+	return (uint64_t)file_time.dwHighDateTime << 32 | file_time.dwLowDateTime;
+}
+
+static uint64_t get_current_ticks()
+{
+	FILETIME now;
+
+	GetSystemTimeAsFileTime(&now);
+	return to_ticks(now);
+}
+
+// Return the number of freezes written in freezes, and if a process is over its threshold
+static size_t sample(Freeze* freezes, bool& is_over_threshold)
+{
+	size_t nb_freezes = 0;
+
+	is_over_threshold = false;
+
+	EnterCriticalSection(&watched_processes_critical_section);
+	for (size_t i = 0; i < nb_watched_processes;)
+	{
+		Watched_Process&	watched = watched_processes[i];
+		FILETIME			creation_time, exit_time, kernel_time, user_time;
+		uint64_t			now = get_current_ticks();
+		bool				has_exited = WaitForSingleObject(watched.process_handle, 0) == WAIT_OBJECT_0;
+
+		GetProcessTimes(watched.process_handle, &creation_time, &exit_time, &kernel_time, &user_time);
+
+		uint64_t cpu_time = to_ticks(user_time) + to_ticks(kernel_time);
+		uint64_t wall_duration = now - watched.last_sample_time;
+		bool is_over = wall_duration > 0 && (cpu_time - watched.last_cpu_time) * 100 >= watched.cpu_threshold_percent * wall_duration;
+
+		if (is_over && watched.over_threshold_since == 0)
+		{
+			watched.over_threshold_since = watched.last_sample_time;
+			watched.over_threshold_user_time = watched.last_user_time;
+			watched.over_threshold_kernel_time = watched.last_kernel_time;
+		}
+
+		if (watched.over_threshold_since && (!is_over || has_exited))
+		{
+			// The freeze ended between the two last samples, take the one that keeps a conservative duration
+			uint64_t end_time = is_over ? now : watched.last_sample_time;
+			uint64_t end_user_time = is_over ? to_ticks(user_time) : watched.last_user_time;
+			uint64_t end_kernel_time = is_over ? to_ticks(kernel_time) : watched.last_kernel_time;
+
+			if (end_time - watched.over_threshold_since >= (uint64_t)watched.minimum_duration_ms * 10'000)
+			{
+				Freeze& freeze = freezes[nb_freezes++];
+
+				freeze.group_id = watched.group_id;
+				freeze.process_name_id = watched.process_name_id;
+				freeze.entry = { watched.over_threshold_since, end_time };
+				freeze.resources = {};
+				freeze.resources.start_time = watched.over_threshold_since;
+				freeze.resources.end_time = end_time;
+				freeze.resources.user_time_ms = (uint32_t)((end_user_time - watched.over_threshold_user_time) / 10'000);
+				freeze.resources.kernel_time_ms = (uint32_t)((end_kernel_time - watched.over_threshold_kernel_time) / 10'000);
+			}
+			watched.over_threshold_since = 0;
+		}
+
+		watched.last_sample_time = now;
+		watched.last_cpu_time = cpu_time;
+		watched.last_user_time = to_ticks(user_time);
+		watched.last_kernel_time = to_ticks(kernel_time);
+
+		if (has_exited)
+		{
+			CloseHandle(watched.process_handle);
+			watched = watched_processes[--nb_watched_processes];
+			continue;
+		}
+
+		is_over_threshold |= watched.over_threshold_since != 0;
+		i++;
+	}
+	LeaveCriticalSection(&watched_processes_critical_section);
+
+	return nb_freezes;
+}
+
+static DWORD WINAPI sampler_thread_main(LPVOID)
+{
+	static Freeze	freezes[maximum_nb_watched_processes];
+	bool			is_over_threshold = false;
+	HANDLE			events[2] = { stop_event, wake_event };
+
+	TRACE_THREAD_NAME("CPU sampler");
+	for (;;)
+	{
+		DWORD timeout;
+
+		EnterCriticalSection(&watched_processes_critical_section);
+		if (nb_watched_processes == 0)
+			timeout = INFINITE;
+		else
+			timeout = is_over_threshold ? fast_sampling_period_ms : slow_sampling_period_ms;
+		LeaveCriticalSection(&watched_processes_critical_section);
+
+		DWORD result = WaitForMultipleObjects(2, events, FALSE, timeout);
+		if (result == WAIT_OBJECT_0)
+			break;
+		if (result == WAIT_OBJECT_0 + 1)
+			continue; // A new process, compute the next timeout
+
+		TRACE_ZONE("cpu_sampler_sample");
+		size_t nb_freezes = sample(freezes, is_over_threshold);
+		if (nb_freezes == 0)
+			continue;
+
+		uint64_t termination_time = get_current_windows_ticks(); // Ends of freezes are seen by this sample
+
+		enter_editing_groups_critical_section();
+		for (size_t i = 0; i < nb_freezes; i++)
+			record_execution(freezes[i].group_id, freezes[i].process_name_id, freezes[i].entry, freezes[i].resources, termination_time);
+		LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+	}
+	return 0;
+}
+
+bool initialize_cpu_sampler()
+{
+	InitializeCriticalSection(&watched_processes_critical_section);
+	stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	sampler_thread = CreateThread(NULL, 0, sampler_thread_main, NULL, 0, NULL);
+
+	return sampler_thread != NULL;
+}
+
+void terminate_cpu_sampler()
+{
+	SetEvent(stop_event);
+	WaitForSingleObject(sampler_thread, INFINITE);
+	CloseHandle(sampler_thread);
+	CloseHandle(stop_event);
+	CloseHandle(wake_event);
+
+	for (size_t i = 0; i < nb_watched_processes; i++)
+		CloseHandle(watched_processes[i].process_handle);
+	nb_watched_processes = 0;
+}
+
+void cpu_sampler_watch(HANDLE process_handle, uint32_t group_id, uint32_t process_name_id, uint32_t cpu_threshold_percent, uint32_t minimum_duration_ms)
+{
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+
+	GetProcessTimes(process_handle, &creation_time, &exit_time, &kernel_time, &user_time);
+
+	Watched_Process watched = {};
+
+	watched.process_handle = process_handle;
+	watched.process_id = GetProcessId(process_handle);
+	watched.group_id = group_id;
+	watched.process_name_id = process_name_id;
+	watched.cpu_threshold_percent = cpu_threshold_percent;
+	watched.minimum_duration_ms = minimum_duration_ms;
+	watched.last_sample_time = get_current_ticks();
+	watched.last_user_time = to_ticks(user_time);
+	watched.last_kernel_time = to_ticks(kernel_time);
+	watched.last_cpu_time = watched.last_user_time + watched.last_kernel_time;
+
+	EnterCriticalSection(&watched_processes_critical_section);
+	// Running processes are attached again when a group is edited
+	bool is_already_watched = std::any_of(watched_processes, watched_processes + nb_watched_processes,
+		[&watched](const Watched_Process& other) { return other.process_id == watched.process_id && other.group_id == watched.group_id; });
+
+	if (!is_already_watched && nb_watched_processes < maximum_nb_watched_processes)
+	{
+		watched_processes[nb_watched_processes++] = watched;
+		process_handle = NULL;
+	}
+	LeaveCriticalSection(&watched_processes_critical_section);
+
+	if (process_handle) // Too many watched processes, or already watched
+		CloseHandle(process_handle);
+	else
+		SetEvent(wake_event);
+}
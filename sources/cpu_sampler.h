@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Windows.h>
+
+#include <cstdint>
+
+// Detect freezes (an IDE blocked on a long computation,...) by sampling the CPU usage of watched
+// processes. A period where a process use more than a threshold of a core during at least a minimum
+// duration is recorded as an execution of its group.
+//
+// Sampling is done by a dedicated thread, slowly while processes are under their threshold and faster
+// when one is over it to get precise edges. There is no sampling at all without watched processes.
+
+bool initialize_cpu_sampler();
+void terminate_cpu_sampler();
+
+// Take the ownership of process_handle (PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE is enough),
+// it is closed when the process terminates. Watching a process again for the same group does nothing.
+void cpu_sampler_watch(HANDLE process_handle, uint32_t group_id, uint32_t process_name_id, uint32_t cpu_threshold_percent, uint32_t minimum_duration_ms);
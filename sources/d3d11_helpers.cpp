@@ -1,5 +1,8 @@
 #include "d3d11_helpers.h"
 
+#include "diagnostics.h"
+#include "trace.h"
+
 #include <imgui/backends/imgui_impl_dx11.h>
 
 #include <d3d11.h>
@@ -31,6 +34,8 @@ void d3d11_present_framebuffer()
     g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color_with_alpha);
     ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
+    TRACE_ZONE("Present");
+    Diagnostic_Scope present(Diagnostic_Series::present);
     g_pSwapChain->Present(1, 0); // Present with vsync
     //g_pSwapChain->Present(0, 0); // Present without vsync
 }
@@ -0,0 +1,79 @@
+#include "diagnostics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+#include <cassert>
+
+static_assert((diagnostic_history_size & (diagnostic_history_size - 1)) == 0, "diagnostic_history_size should be a power of 2");
+
+struct Diagnostic_Ring
+{
+	std::atomic<uint64_t>	nb_samples = 0; // Since the start, the last diagnostic_history_size ones are in samples_ns
+	std::atomic<uint64_t>	samples_ns[diagnostic_history_size] = {};
+};
+
+static Diagnostic_Ring diagnostic_rings[(size_t)Diagnostic_Series::count];
+
+const char* get_diagnostic_series_label(Diagnostic_Series series)
+{
+	constexpr const char* labels[] = { "Ingest", "View generation", "Plot", "Present", "Frame", "Groups lock wait" };
+	static_assert(std::size(labels) == (size_t)Diagnostic_Series::count);
+
+	return labels[(size_t)series];
+}
+
+void record_diagnostic_sample(Diagnostic_Series series, uint64_t duration_ns)
+{
+	Diagnostic_Ring&	ring = diagnostic_rings[(size_t)series];
+	uint64_t			index = ring.nb_samples.fetch_add(1, std::memory_order_relaxed);
+
+	ring.samples_ns[index & (diagnostic_history_size - 1)].store(duration_ns, std::memory_order_relaxed);
+}
+
+size_t get_diagnostic_samples(Diagnostic_Series series, double* samples_ms, size_t capacity)
+{
+	const Diagnostic_Ring&	ring = diagnostic_rings[(size_t)series];
+	uint64_t				end = ring.nb_samples.load(std::memory_order_relaxed);
+	uint64_t				nb_samples = std::min<uint64_t>({ end, diagnostic_history_size, capacity });
+
+	for (uint64_t i = 0; i < nb_samples; i++)
+		samples_ms[i] = ring.samples_ns[(end - nb_samples + i) & (diagnostic_history_size - 1)].load(std::memory_order_relaxed) / 1'000'000.0;
+	return (size_t)nb_samples;
+}
+
+// Samples of the tests shouldn't be shown by the diagnostics window
+static void reset_diagnostic_samples()
+{
+	for (Diagnostic_Ring& ring : diagnostic_rings)
+	{
+		ring.nb_samples.store(0, std::memory_order_relaxed);
+		for (std::atomic<uint64_t>& sample_ns : ring.samples_ns)
+			sample_ns.store(0, std::memory_order_relaxed);
+	}
+}
+
+void test_diagnostics()
+{
+	double samples_ms[diagnostic_history_size];
+
+	assert(get_diagnostic_samples(Diagnostic_Series::present, samples_ms, 0) == 0);
+
+	// The ring keeps the last samples, oldest first
+	for (uint64_t i = 0; i < diagnostic_history_size + 10; i++)
+		record_diagnostic_sample(Diagnostic_Series::present, i * 1'000'000);
+	assert(get_diagnostic_samples(Diagnostic_Series::present, samples_ms, diagnostic_history_size) == diagnostic_history_size);
+	assert(samples_ms[0] == 10.0 && samples_ms[diagnostic_history_size - 1] == diagnostic_history_size + 9.0);
+
+	assert(get_diagnostic_samples(Diagnostic_Series::present, samples_ms, 2) == 2);
+	assert(samples_ms[0] == diagnostic_history_size + 8.0 && samples_ms[1] == diagnostic_history_size + 9.0);
+
+	{
+		Diagnostic_Scope scope(Diagnostic_Series::present);
+	}
+	assert(get_diagnostic_samples(Diagnostic_Series::present, samples_ms, 1) == 1 && samples_ms[0] < 1000.0);
+
+	reset_diagnostic_samples();
+	assert(get_diagnostic_samples(Diagnostic_Series::present, samples_ms, diagnostic_history_size) == 0);
+}
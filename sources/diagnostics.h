@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+
+#include <cstddef>
+#include <cstdint>
+
+// Samples shown by the diagnostics window: durations of the stages of a frame and waits on locks. Each
+// series keeps its last samples in a fixed size ring, recording one is an atomic increment and a relaxed
+// store, so the cost is the same whether the window is shown or not. Histograms and percentiles are only
+// computed by the window.
+
+enum class Diagnostic_Series : uint32_t
+{
+	ingest,				// Merge of pending executions of all groups (view thread)
+	view_generation,	// Generation of a frame of the view (view thread)
+	plot,				// ImPlot drawing of the graph (render thread)
+	present,			// Present of the swap chain (render thread)
+	frame,				// Whole frame of the render thread
+	groups_lock_wait,	// Contended acquisitions of editing_groups_critical_section (any thread)
+	count,
+};
+
+constexpr size_t diagnostic_history_size = 512; // Samples per series, power of 2
+
+const char*	get_diagnostic_series_label(Diagnostic_Series series);
+
+inline uint64_t get_diagnostic_time_ns()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Any thread
+void		record_diagnostic_sample(Diagnostic_Series series, uint64_t duration_ns);
+
+// Copy the last samples of a series (oldest first) in milliseconds, return their number
+// @Warning Samples recorded during the copy can be mixed with older ones, it is only meant for display
+size_t		get_diagnostic_samples(Diagnostic_Series series, double* samples_ms, size_t capacity);
+
+// Records the lifetime of the scope
+struct Diagnostic_Scope
+{
+	Diagnostic_Series	series;
+	uint64_t			start_ns;
+
+	Diagnostic_Scope(Diagnostic_Series series) : series(series), start_ns(get_diagnostic_time_ns()) {}
+	~Diagnostic_Scope() { record_diagnostic_sample(series, get_diagnostic_time_ns() - start_ns); }
+};
+
+void test_diagnostics();
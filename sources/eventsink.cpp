@@ -1,23 +1,87 @@
 #include "eventsink.h"
 
 #include "application.h"
+#include "cpu_sampler.h"
+#include "object_pool.h"
+#include "trace.h"
+#include "wmi.h"
+
+#include <Psapi.h>
+#include <TlHelp32.h>
+#include <winternl.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include <cassert>
 #include <iostream>
 
 #pragma comment(lib, "wbemuuid.lib")
 
+constexpr uint32_t nb_inline_groups_per_process = 8;
+
+// Groups of a process, the first ones are stored inline so a tracking record doesn't allocate, the others
+// (a process matching many groups) are kept in a vector
+template<typename T>
+struct Process_Group_List
+{
+    T               inline_values[nb_inline_groups_per_process];
+    uint32_t        size = 0;
+    std::vector<T>  overflow_values;
+
+    void push_back(T value)
+    {
+        if (size < nb_inline_groups_per_process)
+            inline_values[size] = value;
+        else
+            overflow_values.push_back(value);
+        size++;
+    }
+
+    T operator[](uint32_t index) const
+    {
+        return index < nb_inline_groups_per_process ? inline_values[index] : overflow_values[index - nb_inline_groups_per_process];
+    }
+
+    bool contains(T value) const
+    {
+        for (uint32_t i = 0; i < size; i++)
+        {
+            if ((*this)[i] == value)
+                return true;
+        }
+        return false;
+    }
+};
+
+// Tracking record of a running process, allocated from a pool as there can be hundreds of thousands
+// of them per hour during builds.
 struct CallbackData
 {
-    std::string tracking_group_name;
-    std::wstring process_name;
-    EventSink* event_sink;
-    uint32_t process_id;
-    HANDLE wait_handle;
+    EventSink*  event_sink;
+    HANDLE      process_handle;
+    HANDLE      wait_handle;
+    uint32_t    process_id;
+    uint32_t    process_name_id; // In g_dear_time.process_names
+    Process_Group_List<uint32_t> tracking_group_ids; // See get_tracking_group_by_id
+    uint32_t    session_generation; // Of its entry in g_dear_time.process_sessions, 0 if not part of a process tree
 };
 
+static Object_Pool<CallbackData> callback_data_pool;
+
+// The pid can already have been reused by a newer process of a session
+static void erase_process_session(uint32_t process_id, uint32_t generation)
+{
+    g_dear_time.process_sessions.erase_if(process_id, [generation](const Process_Session& session) { return session.generation == generation; });
+}
+
 static VOID CALLBACK process_termination_callback(_In_ PVOID lpParameter, _In_ BOOLEAN TimerOrWaitFired)
 {
+    TRACE_ZONE("process_termination_callback");
+
+    uint64_t termination_time = get_current_windows_ticks();
+
     assert(lpParameter);
 
     EnterCriticalSection(&g_dear_time.is_quitting_critical_section);
@@ -32,44 +96,102 @@ static VOID CALLBACK process_termination_callback(_In_ PVOID lpParameter, _In_ B
         {
             // We can't register the record when the application is quiting.
             UnregisterWait(data->wait_handle);
+            callback_data_pool.release(data);
 
             LeaveCriticalSection(&g_dear_time.is_quitting_critical_section);
             return;
         }
 
-        auto it = data->event_sink->handles.find(data->process_id);
-        assert(it != data->event_sink->handles.end());
-        bool is_current_group = false;
+        HANDLE process_handle = data->process_handle;
+
+        GetProcessTimes(process_handle, (LPFILETIME)&entry.start_time, (LPFILETIME)&entry.end_time, &kernel_time, &user_time);
 
-        GetProcessTimes(it->second, (LPFILETIME)&entry.start_time, (LPFILETIME)&entry.end_time, &kernel_time, &user_time);
+        Execution_Resources         resources = {};
+        PROCESS_MEMORY_COUNTERS     memory_counters = {};
+        IO_COUNTERS                 io_counters = {};
 
-        EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
-        Group* tracking_group = get_tracking_group(data->tracking_group_name);
+        resources.start_time = entry.start_time;
+        resources.end_time = entry.end_time;
+        resources.user_time_ms = (uint32_t)(((uint64_t)user_time.dwHighDateTime << 32 | user_time.dwLowDateTime) / 10'000);
+        resources.kernel_time_ms = (uint32_t)(((uint64_t)kernel_time.dwHighDateTime << 32 | kernel_time.dwLowDateTime) / 10'000);
+        if (GetProcessMemoryInfo(process_handle, &memory_counters, sizeof(memory_counters)))
+            resources.peak_memory_kb = (uint32_t)(memory_counters.PeakWorkingSetSize / 1024);
+        if (GetProcessIoCounters(process_handle, &io_counters))
+        {
+            resources.read_bytes = io_counters.ReadTransferCount;
+            resources.write_bytes = io_counters.WriteTransferCount;
+        }
+
+        // The record is taken under the same lock than attach_process looks it up, so a rescan or a creation event
+        // either completes its groups before they are recorded or sees the process as terminated
+        enter_editing_groups_critical_section();
+        CallbackData* tracked_data = nullptr;
+        bool found = data->event_sink->tracked_processes.terminate(data->process_id, entry.start_time, tracked_data);
+        assert(found && tracked_data == data);
 
-        if (tracking_group) // Group may have been destroyed
+        if (data->session_generation)
+            erase_process_session(data->process_id, data->session_generation);
+
+        for (uint32_t i = 0; i < data->tracking_group_ids.size; i++)
         {
-            is_current_group = tracking_group->name == g_dear_time.current_group_name;
-            EnterCriticalSection(&tracking_group->executions_critical_section);
-            {
-                tracking_group->executions.push_back(entry);
-            }
-            LeaveCriticalSection(&tracking_group->executions_critical_section);
+            record_execution(data->tracking_group_ids[i], data->process_name_id, entry, resources, termination_time);
         }
         LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
 
-        CloseHandle(it->second);
-        data->event_sink->handles.erase(it);
+        CloseHandle(process_handle);
 
         UnregisterWait(data->wait_handle);
 
-        delete data;
-
-        if (is_current_group)
-            request_redraw();
+        callback_data_pool.release(data);
     }
     LeaveCriticalSection(&g_dear_time.is_quitting_critical_section);
 }
 
+Tracking_Pool_Stats get_tracking_pool_stats()
+{
+    auto stats = callback_data_pool.get_stats();
+
+    return { stats.nb_used, stats.peak_nb_used, stats.capacity };
+}
+
+// ProcessCommandLineInformation (Windows 8.1) isn't part of the PROCESSINFOCLASS of winternl.h
+constexpr PROCESSINFOCLASS  process_command_line_information = (PROCESSINFOCLASS)60;
+constexpr NTSTATUS          status_info_length_mismatch = (NTSTATUS)0xC0000004;
+
+// Command line of a running process without going through WMI, the result points into buffer
+static std::wstring_view read_process_command_line(uint32_t process_id, std::vector<uint8_t>& buffer)
+{
+    using Nt_Query_Information_Process = NTSTATUS(NTAPI*)(HANDLE, PROCESSINFOCLASS, PVOID, ULONG, PULONG);
+
+    static Nt_Query_Information_Process nt_query_information_process =
+        (Nt_Query_Information_Process)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQueryInformationProcess");
+
+    if (!nt_query_information_process)
+        return {};
+
+    HANDLE process_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, process_id);
+    if (process_handle == NULL)
+        return {};
+
+    ULONG size = 0;
+
+    if (buffer.size() < 4096)
+        buffer.resize(4096);
+    NTSTATUS status = nt_query_information_process(process_handle, process_command_line_information, buffer.data(), (ULONG)buffer.size(), &size);
+    if (status == status_info_length_mismatch)
+    {
+        buffer.resize(size);
+        status = nt_query_information_process(process_handle, process_command_line_information, buffer.data(), (ULONG)buffer.size(), &size);
+    }
+    CloseHandle(process_handle);
+
+    if (status < 0)
+        return {};
+
+    const UNICODE_STRING* command_line = (const UNICODE_STRING*)buffer.data();
+    return std::wstring_view(command_line->Buffer, command_line->Length / sizeof(wchar_t));
+}
+
 // =============================================================================
 
 EventSink::EventSink()
@@ -108,19 +230,239 @@ HRESULT EventSink::QueryInterface(REFIID riid, void** ppv)
     else return E_NOINTERFACE;
 }
 
+// Properties of a process being attached are read lazily as most processes don't match any group
+struct Wmi_Process_Source
+{
+    IWbemClassObject*   process;
+    _variant_t          command_line_variant;
+
+    bool get_process_id(uint32_t& process_id)
+    {
+        _variant_t variant;
+
+        if (FAILED(process->Get(L"ProcessId", 0, &variant, NULL, NULL)))
+            return false;
+        process_id = variant.uintVal;
+        return true;
+    }
+
+    bool get_parent_process_id(uint32_t& parent_process_id)
+    {
+        _variant_t variant;
+
+        if (FAILED(process->Get(L"ParentProcessId", 0, &variant, NULL, NULL)))
+            return false;
+        parent_process_id = variant.uintVal;
+        return true;
+    }
+
+    std::wstring_view get_command_line()
+    {
+        HRESULT hr = process->Get(L"CommandLine", 0, &command_line_variant, NULL, NULL);
+        if (FAILED(hr) || command_line_variant.vt != VT_BSTR) // NULL when we aren't allowed to read it
+            return {};
+        return std::wstring_view(command_line_variant.bstrVal, SysStringLen(command_line_variant.bstrVal));
+    }
+};
+
+// Processes already running when tracking starts, or when a group is edited
+struct Snapshot_Process_Source
+{
+    const PROCESSENTRY32W*  process;
+    std::vector<uint8_t>&   command_line_buffer;
+
+    bool get_process_id(uint32_t& process_id)
+    {
+        process_id = process->th32ProcessID;
+        return true;
+    }
+
+    bool get_parent_process_id(uint32_t& parent_process_id)
+    {
+        parent_process_id = process->th32ParentProcessID;
+        return true;
+    }
+
+    std::wstring_view get_command_line()
+    {
+        return read_process_command_line(process->th32ProcessID, command_line_buffer);
+    }
+};
+
+template<typename Process_Source>
+void EventSink::attach_process(std::wstring_view process_name, Process_Source& source, const Group* only_group)
+{
+    const Group_List* tracking_groups = get_tracking_groups_by_process(process_name);
+
+    // A process started by a process of a tracked tree belongs to the same session whatever its
+    // name, its parent is in the session table if it was, so there is nothing to walk.
+    // @Warning The parent should still be running when the creation event is received (WITHIN 1)
+    Group*      session_group = nullptr;
+    bool        is_inherited_session = false;
+    uint32_t    parent_process_id = 0;
+
+    if (g_dear_time.nb_process_tree_groups && source.get_parent_process_id(parent_process_id))
+    {
+        Process_Session parent_session;
+
+        if (g_dear_time.process_sessions.find(parent_process_id, parent_session))
+        {
+            session_group = get_tracking_group_by_id(parent_session.group_id);
+            if (session_group && (!session_group->track_process_tree || (only_group && session_group != only_group)))
+                session_group = nullptr;
+            is_inherited_session = session_group != nullptr;
+        }
+    }
+
+    if (!tracking_groups && !session_group)
+        return;
+
+    // @Warning we now use id of the group as it can be deleted before the callback is called
+    // Using the pointer isn't safe anymore.
+    // The command line is only read when one of the matching groups filters on it.
+    Process_Group_List<uint32_t>    tracking_group_ids;
+    Process_Group_List<Group*>      freeze_groups; // Watched by the CPU sampler instead
+    std::wstring_view               command_line;
+    bool                            command_line_read = false;
+
+    auto add_group = [&](Group* group)
+    {
+        if (group->freeze_cpu_threshold_percent)
+            freeze_groups.push_back(group);
+        else
+            tracking_group_ids.push_back(group->id);
+    };
+
+    // Descendants aren't filtered by the command line predicates of the session root
+    if (is_inherited_session)
+        add_group(session_group);
+
+    static const Group_List no_groups;
+
+    for (Group* tracking_group : tracking_groups ? *tracking_groups : no_groups)
+    {
+        if (tracking_group == session_group || (only_group && tracking_group != only_group))
+            continue;
+
+        if (!tracking_group->command_line_predicates.empty() && !command_line_read)
+        {
+            command_line = source.get_command_line();
+            command_line_read = true;
+        }
+
+        if (!match_command_line_predicates(tracking_group->command_line_predicates, command_line))
+            continue;
+
+        // @Warning A process is the root of a single session, an inherited one have the priority
+        if (tracking_group->track_process_tree && !session_group)
+            session_group = tracking_group;
+
+        add_group(tracking_group);
+    }
+
+    uint32_t process_id;
+
+    if ((tracking_group_ids.size == 0 && freeze_groups.size == 0) || !source.get_process_id(process_id))
+        return;
+
+    uint32_t process_name_id = g_dear_time.process_names.intern(process_name);
+
+    for (uint32_t group_index = 0; group_index < freeze_groups.size; group_index++)
+    {
+        HANDLE  sampled_process_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, process_id);
+        Group*  freeze_group = freeze_groups[group_index];
+
+        if (sampled_process_handle != NULL)
+            cpu_sampler_watch(sampled_process_handle, freeze_group->id, process_name_id,
+                freeze_group->freeze_cpu_threshold_percent, freeze_group->freeze_minimum_duration_ms);
+    }
+
+    // The process is already waited for (seen by the startup scan and by an event, or a group was edited),
+    // its termination callback takes its record under editing_groups_critical_section so it is still valid.
+    CallbackData* data = nullptr;
+
+    if (tracked_processes.find(process_id, data))
+    {
+        for (uint32_t i = 0; i < tracking_group_ids.size; i++)
+        {
+            if (!data->tracking_group_ids.contains(tracking_group_ids[i]))
+                data->tracking_group_ids.push_back(tracking_group_ids[i]);
+        }
+        return;
+    }
+
+    // Processes of a session are waited even if they are only watched by the CPU sampler, the
+    // termination callback removes them from the session table
+    if (tracking_group_ids.size == 0 && !session_group)
+        return;
+
+    // With SYNCHRONIZE the computed life time doesn't seems accurate, I got things like 252s when launching tracy and killing it immediately (around a s or two)
+    HANDLE process_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, process_id);
+    if (process_handle == NULL)
+        return;
+
+    // An ended process can still be opened while handles on it exist (its parent often keeps one), it is
+    // skipped if its termination was already recorded (a creation event received after a rescan)
+    if (WaitForSingleObject(process_handle, 0) == WAIT_OBJECT_0)
+    {
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+
+        if (GetProcessTimes(process_handle, &creation_time, &exit_time, &kernel_time, &user_time)
+            && tracked_processes.is_terminated(process_id, (uint64_t)creation_time.dwHighDateTime << 32 | creation_time.dwLowDateTime))
+        {
+            CloseHandle(process_handle);
+            return;
+        }
+    }
+
+    data = callback_data_pool.acquire();
+    data->event_sink = this;
+    data->process_handle = process_handle;
+    data->process_id = process_id;
+    data->process_name_id = process_name_id;
+    data->tracking_group_ids = std::move(tracking_group_ids);
+    data->session_generation = 0;
+
+    if (session_group)
+    {
+        data->session_generation = (uint32_t)InterlockedIncrement(&g_dear_time.process_session_generation);
+        g_dear_time.process_sessions.insert(process_id, { session_group->id, data->session_generation });
+
+        // Attaching isn't atomic with the termination: a process that ended since the snapshot (or its creation
+        // event) doesn't pass its session on, its children are already attached or gone. Its execution is still
+        // recorded by the callback.
+        if (WaitForSingleObject(process_handle, 0) == WAIT_OBJECT_0)
+        {
+            erase_process_session(process_id, data->session_generation);
+            data->session_generation = 0;
+        }
+    }
+
+    tracked_processes.insert(process_id, data);
+    if (!RegisterWaitForSingleObject(&data->wait_handle, process_handle, process_termination_callback, data, INFINITE, WT_EXECUTEONLYONCE))
+    {
+        // Without callback nothing would remove its entries until the pid is reused
+        CallbackData* tracked_data = nullptr;
+
+        tracked_processes.take(process_id, tracked_data);
+        if (data->session_generation)
+            erase_process_session(process_id, data->session_generation);
+        CloseHandle(process_handle);
+        callback_data_pool.release(data);
+    }
+}
+
 HRESULT EventSink::Indicate(long lObjectCount,
     IWbemClassObject** apObjArray)
 {
+    TRACE_ZONE("EventSink::Indicate");
+
     HRESULT hr = S_OK;
     _variant_t vtProp;
     bool is_delete = false;
 
     for (int i = 0; i < lObjectCount; i++)
     {
-        std::wstring process_name;
-        uint32_t process_id = 0;
-        Group* tracking_group = nullptr;
-
         hr = apObjArray[i]->Get(_bstr_t(L"TargetInstance"), 0, &vtProp, 0, 0);
         if (FAILED(hr))
             continue;
@@ -144,54 +486,85 @@ HRESULT EventSink::Indicate(long lObjectCount,
             continue;
         }
 
-        EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+        enter_editing_groups_critical_section();
         {
-            process_name = cn.bstrVal;
-            tracking_group = get_tracking_group_by_process(process_name);
-            VariantClear(&cn);
-
-            if (!tracking_group)
-            {
-                LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
-                apObjArray[i]->Release();
-                continue;
-            }
-            hr = apObjArray[i]->Get(L"ProcessId", 0, &cn, NULL, NULL);
-            if (FAILED(hr))
-            {
-                LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
-                VariantClear(&cn);
-                apObjArray[i]->Release();
-                continue;
-            }
-            process_id = cn.uintVal;
-            VariantClear(&cn);
+            Wmi_Process_Source source = { apObjArray[i] };
 
-            // With SYNCHRONIZE the computed life time doesn't seems accurate, I got things like 252s when launching tracy and killing it immediately (around a s or two)
-            HANDLE process_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, process_id);
-            if (process_handle != NULL)
-            {
-                handles.insert(std::make_pair(process_id, process_handle));
-
-                CallbackData* data = new CallbackData();
-
-                // @Warning we now use name of the group as it can be deleted before the callback is called
-                // Using the pointer isn't safe anymore.
-                data->tracking_group_name = tracking_group->name;
-                data->process_name = std::move(process_name);
-                data->event_sink = this;
-                data->process_id = process_id;
-                BOOL result = RegisterWaitForSingleObject(&data->wait_handle, process_handle, process_termination_callback, data, INFINITE, WT_EXECUTEONLYONCE);
-                int i = 0;
-            }
+            // @Warning No copy here, the name is only read until cn is cleared
+            attach_process(std::wstring_view(cn.bstrVal, SysStringLen(cn.bstrVal)), source, nullptr);
         }
         LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+        VariantClear(&cn);
         apObjArray[i]->Release();
     }
 
     return WBEM_S_NO_ERROR;
 }
 
+// Tree depth of a process in the snapshot (1 for roots), as parents should be attached before their
+// children to pass their session on. Pids can be reused, a cycle is cut where it is entered.
+static uint32_t get_snapshot_depth(size_t index, const std::vector<PROCESSENTRY32W>& processes,
+    const std::unordered_map<uint32_t, size_t>& indices_by_pid, std::vector<uint32_t>& depths)
+{
+    if (depths[index])
+        return depths[index];
+
+    depths[index] = 1;
+    auto it = indices_by_pid.find(processes[index].th32ParentProcessID);
+    if (it != indices_by_pid.end() && it->second != index)
+        depths[index] = get_snapshot_depth(it->second, processes, indices_by_pid, depths) + 1;
+    return depths[index];
+}
+
+void EventSink::attach_running_processes(const Group* only_group)
+{
+    // A single snapshot of all processes, only the ones matching a group are opened
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE)
+        return;
+
+    std::vector<PROCESSENTRY32W>    processes;
+    PROCESSENTRY32W                 process = {};
+
+    processes.reserve(1024);
+    process.dwSize = sizeof(process);
+    for (BOOL has_process = Process32FirstW(snapshot, &process); has_process; has_process = Process32NextW(snapshot, &process))
+        processes.push_back(process);
+    CloseHandle(snapshot);
+
+    std::vector<size_t> order(processes.size());
+
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    enter_editing_groups_critical_section();
+    {
+        if (g_dear_time.nb_process_tree_groups)
+        {
+            std::unordered_map<uint32_t, size_t>    indices_by_pid;
+            std::vector<uint32_t>                   depths(processes.size(), 0);
+
+            indices_by_pid.reserve(processes.size());
+            for (size_t i = 0; i < processes.size(); i++)
+                indices_by_pid[processes[i].th32ProcessID] = i;
+            for (size_t i = 0; i < processes.size(); i++)
+                get_snapshot_depth(i, processes, indices_by_pid, depths);
+
+            std::stable_sort(order.begin(), order.end(), [&depths](size_t a, size_t b) { return depths[a] < depths[b]; });
+        }
+
+        std::vector<uint8_t> command_line_buffer;
+
+        for (size_t index : order)
+        {
+            Snapshot_Process_Source source = { &processes[index], command_line_buffer };
+
+            attach_process(processes[index].szExeFile, source, only_group);
+        }
+    }
+    LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+}
+
 HRESULT EventSink::SetStatus(
     /* [in] */ LONG lFlags,
     /* [in] */ HRESULT hResult,
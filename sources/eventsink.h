@@ -4,20 +4,34 @@
 #include <comdef.h>
 #include <Wbemidl.h>
 
-#include <unordered_map>
+#include "concurrent_pid_map.h"
+
+#include <string_view>
+
+struct Group;
+struct CallbackData;
 
 class EventSink : public IWbemObjectSink
 {
     volatile LONG* m_lRef;
     bool bDone;
-    std::unordered_map<uint32_t, HANDLE> handles;
+    Tracked_Processes<CallbackData> tracked_processes; // Filled by attach_process, emptied by process_termination_callback from the thread pool
 
     friend VOID CALLBACK process_termination_callback(_In_ PVOID lpParameter, _In_ BOOLEAN TimerOrWaitFired);
 
+    // Match a process against groups and wait for its termination if needed. When only_group isn't
+    // null other groups are ignored, and a process already waited for is added to only_group.
+    // @Warning editing_groups_critical_section should be locked
+    template<typename Process_Source>
+    void attach_process(std::wstring_view process_name, Process_Source& source, const Group* only_group);
+
 public:
     EventSink();
     ~EventSink();
 
+    // Attach processes started before tracking (or before only_group was edited), events only report new ones
+    void attach_running_processes(const Group* only_group);
+
     virtual ULONG STDMETHODCALLTYPE AddRef();
     virtual ULONG STDMETHODCALLTYPE Release();
     virtual HRESULT
@@ -0,0 +1,166 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <new>
+
+#include <cassert>
+#include <cstdlib>
+
+// Blocks are taken with malloc, so the arena itself isn't counted as heap allocations of operator new
+void Frame_Arena::initialize(size_t capacity)
+{
+	assert(memory == nullptr);
+
+	this->capacity = capacity;
+	memory = (char*)malloc(capacity);
+	used = 0;
+}
+
+void Frame_Arena::terminate()
+{
+	reset();
+	free(memory);
+	memory = nullptr;
+	capacity = 0;
+}
+
+void Frame_Arena::reset()
+{
+	while (overflow_blocks)
+	{
+		Overflow_Block* next = overflow_blocks->next;
+
+		free(overflow_blocks);
+		overflow_blocks = next;
+	}
+
+	// Enough for the whole previous frame, with some slack
+	if (overflow_size)
+	{
+		capacity = std::max(capacity * 2, used + overflow_size);
+		free(memory);
+		memory = (char*)malloc(capacity);
+	}
+	used = 0;
+	overflow_size = 0;
+}
+
+void* Frame_Arena::allocate(size_t size, size_t alignment)
+{
+	size_t offset = (used + alignment - 1) & ~(alignment - 1);
+
+	if (offset + size <= capacity)
+	{
+		used = offset + size;
+		return memory + offset;
+	}
+
+	// The header keeps the alignment of the returned memory
+	size_t			header_size = std::max(sizeof(Overflow_Block), alignof(std::max_align_t));
+	Overflow_Block*	block = (Overflow_Block*)malloc(header_size + size);
+
+	assert(alignment <= alignof(std::max_align_t));
+	block->next = overflow_blocks;
+	overflow_blocks = block;
+	overflow_size += size;
+	return (char*)block + header_size;
+}
+
+#if defined(_DEBUG)
+
+static thread_local uint64_t	nb_heap_allocations = 0;
+static thread_local uint32_t	no_heap_allocation_depth = 0;
+
+uint64_t get_nb_heap_allocations()
+{
+	return nb_heap_allocations;
+}
+
+No_Heap_Allocation_Scope::No_Heap_Allocation_Scope()
+{
+	no_heap_allocation_depth++;
+}
+
+No_Heap_Allocation_Scope::~No_Heap_Allocation_Scope()
+{
+	no_heap_allocation_depth--;
+}
+
+// Replacements of the global allocation functions, the nothrow forms call these ones
+void* operator new(size_t size)
+{
+	assert(no_heap_allocation_depth == 0 && "Heap allocation in a steady state path of a frame, use the frame arena");
+	nb_heap_allocations++;
+
+	void* pointer = malloc(size ? size : 1);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+#endif
+
+void test_frame_arena()
+{
+	Frame_Arena arena;
+
+	arena.initialize(64);
+
+	char*		string = arena.allocate_string(3);
+	uint64_t*	value = (uint64_t*)arena.allocate(sizeof(uint64_t), alignof(uint64_t));
+
+	assert((uintptr_t)value % alignof(uint64_t) == 0);
+	assert((char*)value >= string + 3 && (char*)value + sizeof(uint64_t) <= arena.memory + arena.capacity);
+
+	// Memory is reused after a reset
+	arena.reset();
+	assert(arena.allocate_string(3) == string);
+
+	// Overflows are served from the heap, the next frame fits in the arena
+	char* big = arena.allocate_string(100);
+	assert(big < arena.memory || big >= arena.memory + arena.capacity);
+	assert(arena.overflow_size == 100);
+
+	arena.reset();
+	assert(arena.capacity >= 103 && arena.overflow_blocks == nullptr);
+	big = arena.allocate_string(100);
+	assert(big >= arena.memory && big + 100 <= arena.memory + arena.capacity);
+
+#if defined(_DEBUG)
+	uint64_t nb_allocations = get_nb_heap_allocations();
+	{
+		No_Heap_Allocation_Scope no_heap_allocation;
+
+		arena.reset();
+		arena.allocate_string(100);
+	}
+	assert(get_nb_heap_allocations() == nb_allocations);
+#endif
+
+	arena.terminate();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Bump allocator for temporaries of a frame (formatted texts, converted names,...), they are all
+// released at once by reset at the start of the next frame. When a frame needs more than the capacity
+// the missing memory is taken from the heap, and the arena grows to the peak usage on the next reset,
+// so in the steady state a frame doesn't touch the heap.
+// @Warning Not thread safe, should be used from the render thread
+struct Frame_Arena
+{
+	struct Overflow_Block
+	{
+		Overflow_Block*	next;
+	};
+
+	char*			memory = nullptr;
+	size_t			capacity = 0;
+	size_t			used = 0;
+	size_t			overflow_size = 0; // Allocated in overflow blocks since the last reset
+	Overflow_Block*	overflow_blocks = nullptr;
+
+	void	initialize(size_t capacity);
+	void	terminate();
+	void	reset();
+
+	void*	allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	char*	allocate_string(size_t size) { return (char*)allocate(size, 1); }
+};
+
+#if defined(_DEBUG)
+// Number of heap allocations done by the calling thread through operator new
+uint64_t get_nb_heap_allocations();
+
+// Any heap allocation of the calling thread during the lifetime of the scope asserts, to keep the
+// steady state paths of a frame allocation free
+struct No_Heap_Allocation_Scope
+{
+	No_Heap_Allocation_Scope();
+	~No_Heap_Allocation_Scope();
+};
+#endif
+
+void test_frame_arena();
@@ -0,0 +1,141 @@
+#include "group.h"
+
+#include "time.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <cassert>
+
+void add_pending_execution(Group* group, std::wstring_view executable, const RunningEntry& entry, Execution_Resources resources, uint64_t termination_time)
+{
+	std::lock_guard lock(group->executions_mutex);
+
+	uint64_t push_time = get_current_windows_ticks();
+
+	record_capture_latency(Capture_Stage::termination, entry.end_time, termination_time);
+	record_capture_latency(Capture_Stage::push, termination_time, push_time);
+
+	auto it = std::find(group->executables.begin(), group->executables.end(), executable);
+
+	resources.executable_index = (uint32_t)std::distance(group->executables.begin(), it);
+	if (it == group->executables.end())
+		group->executables.emplace_back(executable);
+
+	group->executions.push_back(entry);
+	group->executions_resources.push_back(resources);
+	group->executions_push_times.push_back(push_time);
+}
+
+template<typename T>
+static size_t get_allocated_bytes(const std::vector<T>& vector)
+{
+	return vector.capacity() * sizeof(T);
+}
+
+void update_group_memory_bytes(Group* group)
+{
+	std::lock_guard lock(group->executions_mutex);
+
+	const Concurrency_Timeline& concurrency = group->concurrency;
+	size_t bytes = sizeof(Group);
+
+	bytes += get_allocated_bytes(group->executions) + get_allocated_bytes(group->executions_resources) + get_allocated_bytes(group->executions_push_times);
+	bytes += get_allocated_bytes(group->merged_executions) + get_allocated_bytes(group->resources);
+	bytes += get_allocated_bytes(group->executables);
+	for (const std::wstring& executable : group->executables)
+		bytes += executable.capacity() * sizeof(wchar_t);
+	bytes += get_allocated_bytes(concurrency.step_times) + get_allocated_bytes(concurrency.step_counts);
+	bytes += get_allocated_bytes(concurrency.exclusive_times) + get_allocated_bytes(concurrency.drained_running);
+	bytes += get_allocated_bytes(concurrency.sweep.exclusive_times) + get_allocated_bytes(concurrency.sweep.running);
+	bytes += get_allocated_bytes(concurrency.checkpoints);
+	for (const Concurrency_Timeline::Sweep_State& checkpoint : concurrency.checkpoints)
+		bytes += get_allocated_bytes(checkpoint.exclusive_times) + get_allocated_bytes(checkpoint.running);
+	group->memory_bytes.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t merge_pending_executions(Group* group, std::vector<Execution_Capture>* merged_captures)
+{
+	uint64_t earliest_change = UINT64_MAX;
+
+	{
+		std::lock_guard lock(group->executions_mutex);
+
+		if (group->executions.empty())
+			return earliest_change;
+
+		uint64_t merge_time = get_current_windows_ticks();
+
+		// Merge entries
+		group->merged_executions.reserve(group->merged_executions.size() + group->executions.size());
+		for (size_t i = 0; i < group->executions.size(); i++)
+		{
+			insert_merge_entry(group->merged_executions, group->executions[i]);
+
+			record_capture_latency(Capture_Stage::merge, group->executions_push_times[i], merge_time);
+			if (merged_captures)
+				merged_captures->push_back({ group->executions[i].end_time, merge_time });
+
+			// The execution can have been merged with previous ones, its merged execution start before it
+			auto it = std::upper_bound(group->merged_executions.begin(), group->merged_executions.end(), group->executions[i].start_time,
+				[](uint64_t start_time, const RunningEntry& merged_execution) { return start_time < merged_execution.start_time; });
+			earliest_change = std::min(earliest_change, std::prev(it)->start_time);
+		}
+		group->executions.clear();
+		group->executions_push_times.clear();
+
+		// Resources are kept per execution, they arrive almost sorted (by termination)
+		for (const Execution_Resources& resources : group->executions_resources)
+		{
+			auto it = std::upper_bound(group->resources.begin(), group->resources.end(), resources.start_time,
+				[](uint64_t start_time, const Execution_Resources& other) { return start_time < other.start_time; });
+
+			// The sweep is continued from the last checkpoint before an execution inserted among the processed ones
+			group->concurrency.rewind((size_t)std::distance(group->resources.begin(), it));
+			group->resources.insert(it, resources);
+		}
+		group->executions_resources.clear();
+	}
+
+	group->concurrency.update(group->resources);
+	update_group_memory_bytes(group);
+	return earliest_change;
+}
+
+void test_group()
+{
+	Group group;
+
+	assert(merge_pending_executions(&group) == UINT64_MAX);
+
+	add_pending_execution(&group, L"cl.exe", { 100, 200 }, { 100, 200, 0, 0, 0, 0, 0, 0 }, 200);
+	add_pending_execution(&group, L"link.exe", { 300, 400 }, { 300, 400, 0, 0, 0, 0, 0, 0 }, 400);
+	add_pending_execution(&group, L"cl.exe", { 150, 250 }, { 150, 250, 0, 0, 0, 0, 0, 0 }, 250);
+	assert(group.executables.size() == 2);
+	assert(group.executions_resources[1].executable_index == 1 && group.executions_resources[2].executable_index == 0);
+
+	assert(merge_pending_executions(&group) == 100);
+	assert(group.executions.empty() && group.executions_resources.empty());
+	assert(group.merged_executions.size() == 2);
+	assert(group.merged_executions[0].start_time == 100 && group.merged_executions[0].end_time == 250);
+	assert(group.resources.size() == 3 && group.resources[1].start_time == 150);
+	assert(group.memory_bytes >= sizeof(Group) + 2 * sizeof(RunningEntry) + 3 * sizeof(Execution_Resources));
+
+	// A later execution merged with the first one changes the history from its start
+	add_pending_execution(&group, L"cl.exe", { 240, 260 }, { 240, 260, 0, 0, 0, 0, 0, 0 }, 260);
+	assert(merge_pending_executions(&group) == 100);
+	add_pending_execution(&group, L"cl.exe", { 500, 600 }, { 500, 600, 0, 0, 0, 0, 0, 0 }, 600);
+	assert(merge_pending_executions(&group) == 500);
+	assert(group.merged_executions.size() == 3);
+
+	// Dates of merged executions are given to measure when they are shown
+	std::vector<Execution_Capture> merged_captures;
+
+	add_pending_execution(&group, L"cl.exe", { 700, 800 }, { 700, 800, 0, 0, 0, 0, 0, 0 }, 800);
+	assert(merge_pending_executions(&group, &merged_captures) == 700);
+	assert(merged_captures.size() == 1 && merged_captures[0].end_time == 800 && merged_captures[0].merge_time > 800);
+	assert(group.executions_push_times.empty());
+
+	// Dates of these executions are far in the past, their latencies shouldn't stay in the histograms
+	reset_capture_lag_histograms();
+}
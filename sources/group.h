@@ -0,0 +1,66 @@
+#pragma once
+
+#include "capture_lag.h"
+#include "intervals.h"
+#include "concurrency.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+// A group of tracked processes and the history of their executions. The group model, merging and record
+// I/O only depend on the standard library, they are shared by the application and the headless daemon.
+
+struct Group
+{
+	std::string							name;
+	uint32_t							id; // Slot index in g_dear_time.groups_by_id (low bits) and generation of the slot (high bits)
+	std::unordered_set<std::wstring>	proccess_names; // @Warning Should be lower case, may contain '*' and '?' wildcards
+	std::vector<std::wstring>			command_line_predicates; // @Warning Should be lower case, one of them should match when not empty
+
+	// When not 0, processes aren't tracked from their start to their termination but during periods where
+	// they use more than freeze_cpu_threshold_percent of a core for at least freeze_minimum_duration_ms (freezes)
+	uint32_t							freeze_cpu_threshold_percent = 0;
+	uint32_t							freeze_minimum_duration_ms = 2000;
+
+	// When true, processes matching proccess_names are roots of sessions, all their descendants are
+	// tracked in the group whatever their names
+	bool								track_process_tree = false;
+
+	std::mutex							executions_mutex;
+	std::vector<RunningEntry>			executions;
+	std::vector<Execution_Resources>	executions_resources; // Pending, same order as executions
+	std::vector<uint64_t>				executions_push_times; // Pending, same order as executions, for the capture lag
+
+	// Names of processes recorded in this group, appended by add_pending_execution (capture threads) under
+	// executions_mutex. In the application the capture threads also hold editing_groups_critical_section,
+	// so the UI can read them under this lock only.
+	std::vector<std::wstring>			executables;
+
+	// Written by the merging thread only, under executions_mutex for backups
+	std::vector<RunningEntry>			merged_executions;
+	std::vector<Execution_Resources>	resources; // One per execution (not merged), sorted by start_time
+	Concurrency_Timeline				concurrency; // Of resources, updated when executions are merged
+	std::atomic<size_t>					memory_bytes = 0; // Allocated by the history, updated when executions are merged
+};
+
+// Push an execution in the pending executions of a group, executable_index of resources is set (any thread)
+// termination_time is the date the capture backend saw the end of the execution (Windows ticks)
+void		add_pending_execution(Group* group, std::wstring_view executable, const RunningEntry& entry, Execution_Resources resources, uint64_t termination_time);
+
+// Merge pending executions of a group, return the start of the earliest merged execution that changed
+// (Windows ticks), UINT64_MAX if there was no pending execution
+// Dates of the merged executions are appended to merged_captures if given, to measure their display
+// @Warning Should always be called from the same thread (view thread of the application)
+uint64_t	merge_pending_executions(Group* group, std::vector<Execution_Capture>* merged_captures = nullptr);
+
+// Update memory_bytes, done by merge_pending_executions
+// @Warning Should be called from the merging thread, or before the group is shared
+void		update_group_memory_bytes(Group* group);
+
+void test_group();
@@ -0,0 +1,165 @@
+#include "intervals.h"
+
+#include <iterator>
+
+#include <cassert>
+
+void insert_merge_entry(std::vector<RunningEntry>& merged_entries, const RunningEntry& entry)
+{
+	bool start_overlap = false;
+	bool end_overlap = false;
+	size_t start_pos = merged_entries.size();
+	size_t end_pos = start_pos + 1;
+
+	// Search the position of start (@Speed reverse iteration)
+	for (size_t i = merged_entries.size() - 1; i != (size_t)-1; i--)
+	{
+		if (entry.start_time > merged_entries[i].end_time) // start_time of entry is just after the current one
+		{
+			start_pos = i + 1;
+			break;
+		}
+		else if (entry.start_time >= merged_entries[i].start_time) // start_time of entry is in the range of the current one
+		{
+			start_pos = i;
+			start_overlap = true;
+			break;
+		}
+		start_pos = i;
+	}
+
+	// Search the position of end (@speed from start_pos)
+	for (end_pos = start_pos + 1; end_pos < merged_entries.size(); end_pos++)
+	{
+		if (entry.end_time < merged_entries[end_pos].start_time) // end_time of entry is just before the next one
+		{
+			break;
+		}
+		else if (entry.end_time <= merged_entries[end_pos].end_time) // end_time of entry is in the range of the next one
+		{
+			end_pos++;
+			end_overlap = true;
+			break;
+		}
+	}
+	// Fix end_overlap with latest range in merged_entries
+	if (end_pos - 1 < merged_entries.size())
+		end_overlap = entry.end_time >= merged_entries[end_pos - 1].start_time;
+
+	// Insertion/Merge
+	if (start_overlap == false && end_overlap == false && start_pos == end_pos - 1)
+	{
+		merged_entries.insert(std::next(merged_entries.begin(), start_pos), entry);
+	}
+	else
+	{
+		merged_entries[start_pos].start_time = std::min(merged_entries[start_pos].start_time, entry.start_time);
+		merged_entries[start_pos].end_time = std::max(merged_entries[end_pos - 1].end_time, entry.end_time);
+		if (start_pos - end_pos > 0)
+			merged_entries.erase(std::next(merged_entries.begin(), start_pos + 1), std::next(merged_entries.begin(), end_pos));
+	}
+}
+
+uint64_t get_optimal_period_duration(double range_start_s, double range_end_s)
+{
+	uint64_t range_size = (uint64_t)(range_end_s - range_start_s);
+	constexpr size_t min_nb_periods = 10; // @TODO may I need to adapt this to the actual plot width (in pixels)?
+
+	if (range_size > 10 * year_duration)
+		return (uint64_t)year_duration;
+	if (range_size > 4 * year_duration)
+		return 6 * (uint64_t)month_duration;
+	if (range_size > 2 * year_duration)
+		return 3 * (uint64_t)month_duration;
+	else if (range_size > 10 * (uint64_t)month_duration)
+		return (uint64_t)month_duration;
+	else if (range_size > 6 * (uint64_t)month_duration)
+		return 2 * week_duration;
+	else if (range_size > 2 * (uint64_t)month_duration)
+		return week_duration;
+	else if (range_size > (uint64_t)month_duration)
+		return 3 * day_duration;
+	else if (range_size > 2 * week_duration)
+		return day_duration;
+	else if (range_size > 6 * day_duration)
+		return 12 * hour_duration;
+	else if (range_size > 2 * day_duration)
+		return 6 * hour_duration;
+	else if (range_size > day_duration)
+		return 2 * hour_duration;
+	else if (range_size > 12 * hour_duration)
+		return 30 * minute_duration;
+	else if (range_size > 4 * hour_duration)
+		return 15 * minute_duration;
+	else if (range_size > hour_duration)
+		return 10 * minute_duration;
+	else if (range_size > 5 * minute_duration)
+		return minute_duration;
+	else if (range_size > minute_duration)
+		return 15 * second_duration;
+
+	return second_duration;
+}
+
+void test_intervals()
+{
+	std::vector<RunningEntry>   initial_entries;
+
+	insert_merge_entry(initial_entries, { 5, 6 });
+	assert(initial_entries == std::vector<RunningEntry>({ {5, 6} }));
+
+	insert_merge_entry(initial_entries, { 7, 8 });
+	assert(initial_entries == std::vector<RunningEntry>({ {5, 6}, {7, 8} }));
+
+	insert_merge_entry(initial_entries, { 1, 3 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, {5, 6}, {7, 8} }));
+
+	insert_merge_entry(initial_entries, { 12, 13 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, {5, 6}, {7, 8}, {12, 13} }));
+
+	insert_merge_entry(initial_entries, { 13, 15 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, {5, 6}, {7, 8}, {12, 15} }));
+
+	insert_merge_entry(initial_entries, { 5, 9 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, { 5, 9}, { 12, 15} }));
+
+	insert_merge_entry(initial_entries, { 2, 4 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 4}, {5, 9}, { 12, 15} }));
+
+	insert_merge_entry(initial_entries, { 10, 13 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 4}, {5, 9}, { 10, 15} }));
+
+	// Merge on edges of ranges
+	initial_entries = { {1, 3}, { 5, 9}, { 12, 15} };
+
+	insert_merge_entry(initial_entries, { 2, 5 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 9}, { 12, 15} }));
+
+	insert_merge_entry(initial_entries, { 9, 13 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 15} }));
+
+	// Multiple merges
+	initial_entries = { {1, 3}, {5, 6}, {7, 8}, {12, 15} };
+	insert_merge_entry(initial_entries, { 1, 12 });
+	assert(initial_entries == std::vector<RunningEntry>({ {1, 15} }));
+
+	initial_entries = { {1, 3}, {5, 6}, {7, 8}, {12, 15} };
+	insert_merge_entry(initial_entries, { 0, 16 });
+	assert(initial_entries == std::vector<RunningEntry>({ {0, 16} }));
+
+	// Aggregation of periods of 10 seconds, entries of the last period are out of the range
+	std::vector<RunningEntry>			merged = { { UnixSecondsToWindowsTick(5), UnixSecondsToWindowsTick(7) },
+		{ UnixSecondsToWindowsTick(12), UnixSecondsToWindowsTick(20) }, { UnixSecondsToWindowsTick(15), UnixSecondsToWindowsTick(16) },
+		{ UnixSecondsToWindowsTick(30), UnixSecondsToWindowsTick(31) } };
+	std::vector<Execution_Resources>	resources(1);
+	std::vector<Period_Bucket>			buckets;
+
+	resources[0] = { UnixSecondsToWindowsTick(12), UnixSecondsToWindowsTick(20), 1, 2, 100, 10, 64, 0 };
+	assert(aggregate_periods(merged, resources, 10, 0, 3, buckets, []() { return false; }));
+	assert(buckets.size() == 3);
+	assert(buckets[0].nb_executions == 1 && buckets[0].total_execution_time == 2 && buckets[0].nb_resources == 0);
+	assert(buckets[1].nb_executions == 2 && buckets[1].total_execution_time == 9 && buckets[1].maximum_duration == 8);
+	assert(buckets[1].nb_resources == 1 && buckets[1].user_time_ms == 100 && buckets[1].peak_memory_kb == 64);
+	assert(buckets[2].nb_executions == 0);
+	assert(!aggregate_periods(merged, resources, 10, 0, 3, buckets, []() { return true; }));
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "time.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels on the history of executions: merge of intervals and aggregation per period. They only depend
+// on the standard library, so they are shared by the application, benchmarks and any capture backend.
+
+struct RunningEntry
+{
+	uint64_t start_time; // Windows ticks (100 nanoseconds) since midnight on January 1, 1601 at Greenwich, England
+	uint64_t end_time; // Windows ticks (100 nanoseconds) since midnight on January 1, 1601 at Greenwich, England
+
+	inline bool operator==(const RunningEntry& other) const
+	{
+		return this->start_time == other.start_time && this->end_time == other.end_time;
+	}
+};
+
+// One execution (not merged) and the resources it used, stored in a side column of the group so the
+// merged start/end array stays compact for merging and drawing
+struct Execution_Resources
+{
+	uint64_t start_time; // Same as RunningEntry::start_time, used to aggregate resources per period
+	uint64_t end_time;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint32_t user_time_ms;
+	uint32_t kernel_time_ms;
+	uint32_t peak_memory_kb; // Peak working set (Windows), maximum resident set size (Linux)
+	uint32_t executable_index; // In Group::executables
+};
+
+inline uint64_t WindowsTickToUnixSeconds(uint64_t windowsTicks)
+{
+	return windowsTicks / WINDOWS_TICK - SEC_TO_UNIX_EPOCH;
+}
+
+inline uint64_t UnixSecondsToWindowsTick(uint64_t unixSeconds)
+{
+	return (unixSeconds + SEC_TO_UNIX_EPOCH) * WINDOWS_TICK;
+}
+
+// Aggregates of the executions and resources starting in a period (a bar of the graph)
+struct Period_Bucket
+{
+	uint64_t	nb_executions = 0; // Merged executions
+	uint64_t	total_execution_time = 0; // In seconds
+	uint64_t	maximum_duration = 0;
+
+	uint64_t	nb_resources = 0; // Executions (not merged)
+	uint64_t	user_time_ms = 0;
+	uint64_t	kernel_time_ms = 0;
+	uint64_t	read_bytes = 0;
+	uint64_t	write_bytes = 0;
+	uint32_t	peak_memory_kb = 0;
+};
+
+// Insert an execution in merged_entries (sorted, without overlaps), overlapping entries are merged
+void		insert_merge_entry(std::vector<RunningEntry>& merged_entries, const RunningEntry& entry);
+
+// Duration of the periods of bars for a visible range (Unix seconds)
+uint64_t	get_optimal_period_duration(double range_start_s, double range_end_s);
+
+constexpr size_t aggregation_check_period = 4096; // In scanned entries, see aggregate_periods
+
+// Aggregate merged executions and resources (both sorted by start_time) starting in the periods
+// [first_period, end_period[, in periods of period_duration seconds since the Unix epoch.
+// is_cancelled is polled every aggregation_check_period entries, false is returned as soon as it is true
+// and buckets are then incomplete.
+template<typename Is_Cancelled>
+bool aggregate_periods(const std::vector<RunningEntry>& merged_executions, const std::vector<Execution_Resources>& resources,
+	uint64_t period_duration, uint64_t first_period, uint64_t end_period, std::vector<Period_Bucket>& buckets, Is_Cancelled is_cancelled)
+{
+	uint64_t range_start = UnixSecondsToWindowsTick(first_period * period_duration);
+	uint64_t range_end = UnixSecondsToWindowsTick(end_period * period_duration);
+
+	buckets.assign(end_period - first_period, Period_Bucket());
+
+	auto execution = std::lower_bound(merged_executions.begin(), merged_executions.end(), range_start,
+		[](const RunningEntry& merged_execution, uint64_t start_time) { return merged_execution.start_time < start_time; });
+
+	for (size_t i = 0; execution != merged_executions.end() && execution->start_time < range_end; ++execution, i++)
+	{
+		if (i % aggregation_check_period == 0 && is_cancelled())
+			return false;
+
+		Period_Bucket&	bucket = buckets[WindowsTickToUnixSeconds(execution->start_time) / period_duration - first_period];
+		uint64_t		duration = (execution->end_time - execution->start_time) / WINDOWS_TICK;
+
+		bucket.nb_executions++;
+		bucket.total_execution_time += duration;
+		bucket.maximum_duration = std::max(duration, bucket.maximum_duration);
+	}
+
+	auto resource = std::lower_bound(resources.begin(), resources.end(), range_start,
+		[](const Execution_Resources& resources, uint64_t start_time) { return resources.start_time < start_time; });
+
+	for (size_t i = 0; resource != resources.end() && resource->start_time < range_end; ++resource, i++)
+	{
+		if (i % aggregation_check_period == 0 && is_cancelled())
+			return false;
+
+		Period_Bucket& bucket = buckets[WindowsTickToUnixSeconds(resource->start_time) / period_duration - first_period];
+
+		bucket.nb_resources++;
+		bucket.user_time_ms += resource->user_time_ms;
+		bucket.kernel_time_ms += resource->kernel_time_ms;
+		bucket.read_bytes += resource->read_bytes;
+		bucket.write_bytes += resource->write_bytes;
+		bucket.peak_memory_kb = std::max(bucket.peak_memory_kb, resource->peak_memory_kb);
+	}
+	return true;
+}
+
+void test_intervals();
@@ -1,7 +1,20 @@
 #include "application.h"
+#include "capture_lag.h"
 
+#include "process_index.h"
+#include "concurrent_pid_map.h"
+#include "concurrency.h"
+#include "cgroup.h"
+#include "diagnostics.h"
 #include "wmi.h"
+#include "cpu_sampler.h"
+#include "frame_arena.h"
+#include "intervals.h"
+#include "group.h"
+#include "records.h"
+#include "trace.h"
 #include "ui.h"
+#include "view.h"
 #include "d3d11_helpers.h"
 
 #include <imgui/imgui.h>
@@ -10,6 +23,8 @@
 #include <imgui/backends/imgui_impl_dx11.h>
 
 #include <Windows.h>
+#include <windowsx.h> // GET_X_LPARAM
+#include <shellapi.h> // Shell_NotifyIcon
 #include <tchar.h>
 
 #if defined(_CONSOLE) || defined(_DEBUG)
@@ -23,8 +38,22 @@ DearTime g_dear_time;
 
 void run_tests();
 
+constexpr UINT_PTR size_move_timer_id = 1; // Draw while the window is moved or resized
+constexpr UINT notify_icon_message = WM_APP + 1; // Clicks on the icon of the notification area
+
+static bool             is_renderer_created = false;
+static NOTIFYICONDATA   notify_icon_data = {}; // hWnd is set while the icon is shown
+
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+bool create_renderer(HWND hWnd);
+void release_renderer();
+void enter_background_mode(HWND hWnd);
+bool leave_background_mode(HWND hWnd);
+void remove_notify_icon();
 void draw_application(HWND hWnd);
+void wait_for_events(HWND hWnd);
+bool can_change_output(UINT msg, WPARAM wParam, LPARAM lParam);
 
 #if defined(_CONSOLE) || defined(_DEBUG)
 // https://stackoverflow.com/questions/311955/redirecting-cout-to-a-console-in-windows
@@ -42,6 +71,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
     BindCrtHandlesToStdHandles(true, true, true);
 #endif
 
+    TRACE_THREAD_NAME("Main");
     initialize_application();
 
     // Create application window
@@ -50,52 +80,33 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
     ::RegisterClassEx(&wc);
     HWND hWnd = ::CreateWindow(wc.lpszClassName, _T("Dear Time"), WS_OVERLAPPEDWINDOW, 100, 100, 1280, 800, NULL, NULL, wc.hInstance, NULL);
 
-    // Initialize Direct3D
-    if (!CreateDeviceD3D(hWnd))
+    // Initialize Direct3D, Dear ImGui and ImPlot
+    if (!create_renderer(hWnd))
     {
-        CleanupDeviceD3D();
         ::UnregisterClass(wc.lpszClassName, wc.hInstance);
         return 1;
     }
+    ImGui_ImplWin32_EnableDpiAwareness();
 
     // Show the window
     ::ShowWindow(hWnd, SW_SHOWDEFAULT);
     ::UpdateWindow(hWnd);
 
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImPlot::CreateContext();
-
-    initialize_ui();
+    if (!initialize_wmi_events_sink())
+        return 1; // Program has failed.
 
-    // Setup Platform/Renderer backends
-    d3d11_init();
-    ImGui_ImplWin32_Init(hWnd);
-    ImGui_ImplWin32_EnableDpiAwareness();
+    if (!initialize_cpu_sampler())
+        return 1;
 
-    // Load Fonts
-    // - If no fonts are loaded, dear imgui will use the default font. You can also load multiple fonts and use ImGui::PushFont()/PopFont() to select them.
-    // - AddFontFromFileTTF() will return the ImFont* so you can store it if you need to select the font among multiple.
-    // - If the file cannot be loaded, the function will return NULL. Please handle those errors in your application (e.g. use an assertion, or display an error and quit).
-    // - The fonts will be rasterized at a given size (w/ oversampling) and stored into a texture when calling ImFontAtlas::Build()/GetTexDataAsXXXX(), which ImGui_ImplXXXX_NewFrame below will call.
-    // - Read 'docs/FONTS.md' for more instructions and details.
-    // - Remember that in C/C++ if you want to include a backslash \ in a string literal you need to write a double backslash \\ !
-    //io.Fonts->AddFontDefault();
-    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/Roboto-Medium.ttf", 16.0f);
-    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/Cousine-Regular.ttf", 15.0f);
-    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/DroidSans.ttf", 16.0f);
-    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/ProggyTiny.ttf", 10.0f);
-    //ImFont* font = io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\ArialUni.ttf", 18.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
-    //IM_ASSERT(font != NULL);
+    // Builds already running are tracked from now, with their real start time
+    attach_running_processes();
 
-    if (!initialize_wmi_events_sink())
-        return 1; // Program has failed.
+    if (!initialize_view_thread())
+        return 1;
 
     g_dear_time.ready_to_draw = true;
 
-    ImGuiIO& io = ImGui::GetIO();
-    bool previous_WantTextInput = io.WantTextInput;
+    bool previous_WantTextInput = false;
 
     // Main loop
     while (!g_dear_time.done)
@@ -105,21 +116,17 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+        wait_for_events(hWnd);
+
         MSG msg;
         while (::PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
         {
             ::TranslateMessage(&msg);
 
-            // @TODO
-            // DispatchMessage is blocking when the user interact with the window decoration for moving or resing it
-            //
-            // A suggested way to be able to render during this blocking event process is to use WM_TIMER event system.
-            // An other possible solution is to handle manually NC events which can be tricky.
-            //
-            // So it might be interesting to use WM_TIMER with a little higher frequency than the display refresh rate.
-            // I certainly should separate the update and the rendering parts. To be able to do update at higher frequency than
-            // the rendering. The rendering should happens only when the application content changed or when is it requested by the UI.
-            // Ideally I want to use adaptative sync for best UI reactivity. And use the integrated GPU.
+            // DispatchMessage is blocking when the user interact with the window decoration for moving or resing it,
+            // during this modal loop frames are drawn on WM_TIMER (see WndProc). Frames only draw data prepared by
+            // the view thread so they stay cheap.
+            // @TODO Ideally I want to use adaptative sync for best UI reactivity. And use the integrated GPU.
             ::DispatchMessage(&msg);
             if (msg.message == WM_QUIT)
                 g_dear_time.done = true;
@@ -127,15 +134,16 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         if (g_dear_time.done)
             break;
 
-        if (io.WantTextInput != previous_WantTextInput)
+        // In background mode there is no ImGui context, the text edition is stopped by the first frame of the new one
+        if (is_renderer_created && ImGui::GetIO().WantTextInput != previous_WantTextInput)
         {
-            printf("io.WantTextInput %s\n", io.WantTextInput ? "true" : "false");
+            previous_WantTextInput = ImGui::GetIO().WantTextInput;
+            printf("io.WantTextInput %s\n", previous_WantTextInput ? "true" : "false");
 
-            if (io.WantTextInput)
+            if (previous_WantTextInput)
                 start_permanent_redraw();
             else
                 stop_permanent_redraw();
-            previous_WantTextInput = io.WantTextInput;
         }
 
         draw_application(hWnd);
@@ -150,35 +158,161 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
     LeaveCriticalSection(&g_dear_time.is_quitting_critical_section);
 
     terminate_wmi_event_sink();
+    terminate_cpu_sampler();
+    terminate_view_thread();
 
     // Cleanup
+    if (is_renderer_created)
+        release_renderer();
+    remove_notify_icon();
+
+    ::DestroyWindow(hWnd);
+    ::UnregisterClass(wc.lpszClassName, wc.hInstance);
+
+    shutdown_application();
+
+    return 0;   // Program successfully completed.
+}
+
+bool create_renderer(HWND hWnd)
+{
+    TRACE_ZONE("create_renderer");
+
+    if (!CreateDeviceD3D(hWnd))
+    {
+        CleanupDeviceD3D();
+        return false;
+    }
+
+    // Setup Dear ImGui context
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImPlot::CreateContext();
+
+    initialize_ui();
+
+    // Setup Platform/Renderer backends
+    d3d11_init();
+    ImGui_ImplWin32_Init(hWnd);
+
+    // Load Fonts
+    // - If no fonts are loaded, dear imgui will use the default font. You can also load multiple fonts and use ImGui::PushFont()/PopFont() to select them.
+    // - AddFontFromFileTTF() will return the ImFont* so you can store it if you need to select the font among multiple.
+    // - If the file cannot be loaded, the function will return NULL. Please handle those errors in your application (e.g. use an assertion, or display an error and quit).
+    // - The fonts will be rasterized at a given size (w/ oversampling) and stored into a texture when calling ImFontAtlas::Build()/GetTexDataAsXXXX(), which ImGui_ImplXXXX_NewFrame below will call.
+    // - Read 'docs/FONTS.md' for more instructions and details.
+    // - Remember that in C/C++ if you want to include a backslash \ in a string literal you need to write a double backslash \\ !
+    //io.Fonts->AddFontDefault();
+    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/Roboto-Medium.ttf", 16.0f);
+    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/Cousine-Regular.ttf", 15.0f);
+    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/DroidSans.ttf", 16.0f);
+    //io.Fonts->AddFontFromFileTTF("../../misc/fonts/ProggyTiny.ttf", 10.0f);
+    //ImFont* font = io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\ArialUni.ttf", 18.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
+    //IM_ASSERT(font != NULL);
+
+    is_renderer_created = true;
+    return true;
+}
+
+// The ImGui context is saved to imgui.ini when it is destroyed, windows are placed back by the next one
+void release_renderer()
+{
+    TRACE_ZONE("release_renderer");
+
     d3d11_shutdown();
     ImGui_ImplWin32_Shutdown();
+    terminate_ui();
     ImPlot::DestroyContext();
     ImGui::DestroyContext();
 
     CleanupDeviceD3D();
-    ::DestroyWindow(hWnd);
-    ::UnregisterClass(wc.lpszClassName, wc.hInstance);
+    is_renderer_created = false;
+}
 
-    shutdown_application();
+// Background mode: the minimized window is hidden behind an icon of the notification area, the renderer and
+// the frames of the view thread are released, only the capture and the backups keep running. The renderer
+// is rebuilt by the first frame drawn once the window is restored.
+void enter_background_mode(HWND hWnd)
+{
+    TRACE_ZONE("enter_background_mode");
+
+    release_renderer();
+    suspend_view();
+
+    // Freed blocks cached by the heap and pages of the released buffers leave the working set
+    HeapCompact(GetProcessHeap(), 0);
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+
+    notify_icon_data = { sizeof(notify_icon_data) };
+    notify_icon_data.hWnd = hWnd;
+    notify_icon_data.uID = 1;
+    notify_icon_data.uFlags = NIF_MESSAGE | NIF_ICON | NIF_TIP;
+    notify_icon_data.uCallbackMessage = notify_icon_message;
+    notify_icon_data.hIcon = LoadIcon(NULL, IDI_APPLICATION); // @TODO use the icon of the application
+    _tcscpy_s(notify_icon_data.szTip, _T("Dear Time"));
+
+    // Without notification area (no shell) the window stays in the taskbar
+    if (Shell_NotifyIcon(NIM_ADD, &notify_icon_data))
+        ::ShowWindow(hWnd, SW_HIDE);
+    else
+        notify_icon_data.hWnd = NULL;
+}
 
-    return 0;   // Program successfully completed.
+bool leave_background_mode(HWND hWnd)
+{
+    TRACE_ZONE("leave_background_mode");
+
+    remove_notify_icon();
+    if (!create_renderer(hWnd))
+        return false;
+    resume_view();
+    return true;
+}
+
+void remove_notify_icon()
+{
+    if (notify_icon_data.hWnd == NULL)
+        return;
+
+    Shell_NotifyIcon(NIM_DELETE, &notify_icon_data);
+    notify_icon_data.hWnd = NULL;
+}
+
+// Block until a message is received or a redraw is requested (by the UI or by a capture thread), so the
+// main thread doesn't wake up at all while idle and a redraw starts as soon as it is requested.
+void wait_for_events(HWND hWnd)
+{
+    if (*g_dear_time.nb_requested_redraws != 0 && !IsIconic(hWnd))
+        return;
+
+    // MWMO_INPUTAVAILABLE: also return for messages already in the queue but seen by a previous PeekMessage
+    MsgWaitForMultipleObjectsEx(1, &g_dear_time.redraw_event, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
 }
 
 void draw_application(HWND hWnd)
 {
-    if (IsIconic(hWnd)) {
-        Sleep(sleeping_duration_ms);
+    if (IsIconic(hWnd))
+    {
+        if (is_renderer_created)
+            enter_background_mode(hWnd);
         return;  // early return, window is minimized (iconic)
     }
 
-    if (*g_dear_time.nb_requested_redraws == 0) {
-        Sleep(sleeping_duration_ms);
+    if (!is_renderer_created && !leave_background_mode(hWnd))
+    {
+        printf("Failed to create the renderer\n");
+        g_dear_time.done = true;
         return;
     }
+
+    if (*g_dear_time.nb_requested_redraws == 0)
+        return;
     // g_dear_time.nb_requested_redraws may have been incremented since the test, but it is not an issue.
     InterlockedDecrement(g_dear_time.nb_requested_redraws);
+    g_dear_time.nb_drawn_frames++;
+
+    TRACE_ZONE("draw_application");
+    Diagnostic_Scope frame(Diagnostic_Series::frame);
 
     // Start the Dear ImGui frame
     ImGui_ImplDX11_NewFrame();
@@ -199,14 +333,15 @@ extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg
 // Win32 message handler
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-    if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
+    if (is_renderer_created && ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
         return true;
 
-    // @Warning Actually ImGUI can't tell us if an event trigger an interaction with the UI.
-    // So we request a redraw for every events we receive.
-    // Optimally we should only handle Window events (resize, redraw request,...) and UI interactions
-    // (butons clicks, hover effects, text edition, UI animations (text cursor), ...)
-    request_redraw();
+    // Only messages that can change the output request frames, mouse moves, timers and notifications
+    // of the system are the most frequent and usually don't
+    if (can_change_output(msg, wParam, lParam))
+        request_redraw();
+    else
+        g_dear_time.nb_ignored_messages++;
 
     switch (msg)
     {
@@ -217,6 +352,24 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
         if (g_dear_time.ready_to_draw)
             draw_application(hWnd);
         return 0;
+    case WM_ENTERSIZEMOVE:
+        SetTimer(hWnd, size_move_timer_id, USER_TIMER_MINIMUM, NULL);
+        return 0;
+    case WM_EXITSIZEMOVE:
+        KillTimer(hWnd, size_move_timer_id);
+        return 0;
+    case WM_TIMER:
+        if (wParam == size_move_timer_id && g_dear_time.ready_to_draw)
+            draw_application(hWnd);
+        return 0;
+    case notify_icon_message:
+        if (lParam == WM_LBUTTONUP || lParam == WM_LBUTTONDBLCLK)
+        {
+            remove_notify_icon();
+            ::ShowWindow(hWnd, SW_RESTORE);
+            ::SetForegroundWindow(hWnd);
+        }
+        return 0;
     case WM_SYSCOMMAND:
         if ((wParam & 0xfff0) == SC_KEYMENU) // Disable ALT application menu
             return 0;
@@ -237,9 +390,48 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return ::DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
+// @Warning ImGui can't tell if a message triggers an interaction with the UI, messages are classified
+// from what the UI shows: window changes, clicks, wheel and keys always request frames, mouse moves only
+// over something interactive (see ui_is_mouse_move_relevant). Text edition (cursor) uses the permanent redraw.
+bool can_change_output(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+    case WM_SIZE:
+    case WM_PAINT:
+    case WM_SHOWWINDOW:
+    case WM_ACTIVATE:
+    case WM_SETFOCUS:
+    case WM_KILLFOCUS:
+    case WM_DISPLAYCHANGE:
+    case WM_DPICHANGED:
+        return true;
+    case WM_TIMER:
+        return wParam == size_move_timer_id; // The window is being resized
+    case WM_MOUSEMOVE:
+        return ui_is_mouse_move_relevant((float)GET_X_LPARAM(lParam), (float)GET_Y_LPARAM(lParam));
+    case WM_MOUSELEAVE:
+        return ui_is_mouse_move_relevant(-1.0f, -1.0f);
+    }
+
+    // Buttons and wheels, keys and characters
+    return (msg > WM_MOUSEMOVE && msg <= WM_MOUSELAST) || (msg >= WM_KEYFIRST && msg <= WM_KEYLAST);
+}
+
 static void run_tests()
 {
-    test_ui_insert_merge_entry();
+    test_intervals();
+    test_group();
+    test_capture_lag();
+    test_records();
+    test_trace();
+    test_diagnostics();
+    test_view_cache();
+    test_process_index();
+    test_concurrent_pid_map();
+    test_concurrency_timeline();
+    test_cgroup();
+    test_frame_arena();
 }
 
 #if defined(_CONSOLE) || defined(_DEBUG)
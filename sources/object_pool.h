@@ -0,0 +1,86 @@
+#pragma once
+
+#include "spin_lock.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <cstdint>
+
+// Pool of fixed size objects, allocated by chunks which are never returned to the system.
+// Freed objects go in an intrusive free list, so in steady state acquire/release don't allocate.
+// Can be used from any thread, the lock is only held to pop/push the free list.
+template<typename T, size_t nb_objects_per_chunk = 256>
+class Object_Pool
+{
+	union Slot
+	{
+		Slot*	next_free;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	Spin_Lock							m_lock;
+	Slot*								m_free_list = nullptr;
+	std::vector<std::unique_ptr<Slot[]>>	m_chunks;
+	size_t								m_nb_used = 0;
+	size_t								m_peak_nb_used = 0;
+
+public:
+	struct Stats
+	{
+		size_t nb_used;
+		size_t peak_nb_used;
+		size_t capacity;
+	};
+
+	Object_Pool() = default;
+	Object_Pool(const Object_Pool&) = delete;
+	Object_Pool& operator=(const Object_Pool&) = delete;
+
+	template<typename... Args>
+	T* acquire(Args&&... args)
+	{
+		Slot* slot;
+		{
+			std::lock_guard<Spin_Lock> guard(m_lock);
+
+			if (m_free_list == nullptr)
+			{
+				// @Warning Allocating under the spin lock, but it only happens when the pool grows
+				std::unique_ptr<Slot[]> chunk(new Slot[nb_objects_per_chunk]);
+
+				for (size_t i = 0; i < nb_objects_per_chunk; i++)
+					chunk[i].next_free = (i + 1 < nb_objects_per_chunk) ? &chunk[i + 1] : nullptr;
+				m_free_list = &chunk[0];
+				m_chunks.push_back(std::move(chunk));
+			}
+			slot = m_free_list;
+			m_free_list = slot->next_free;
+			m_nb_used++;
+			m_peak_nb_used = std::max(m_peak_nb_used, m_nb_used);
+		}
+		return new (slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void release(T* object)
+	{
+		object->~T();
+
+		Slot* slot = reinterpret_cast<Slot*>(object);
+		std::lock_guard<Spin_Lock> guard(m_lock);
+
+		slot->next_free = m_free_list;
+		m_free_list = slot;
+		m_nb_used--;
+	}
+
+	Stats get_stats()
+	{
+		std::lock_guard<Spin_Lock> guard(m_lock);
+
+		return { m_nb_used, m_peak_nb_used, m_chunks.size() * nb_objects_per_chunk };
+	}
+};
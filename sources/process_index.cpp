@@ -0,0 +1,430 @@
+#include "process_index.h"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+uint16_t Glob_Matcher::get_class(wchar_t folded_char) const
+{
+	if ((uint32_t)folded_char < 128)
+		return ascii_classes[folded_char];
+
+	auto it = other_classes.find(folded_char);
+	if (it == other_classes.end())
+		return 0;
+	return it->second;
+}
+
+size_t Glob_Matcher::Nfa_States_Hash::operator()(const std::vector<uint32_t>& nfa_states) const
+{
+	uint64_t hash = 14'695'981'039'346'656'037ull;
+
+	for (uint32_t nfa_state : nfa_states)
+	{
+		hash ^= nfa_state;
+		hash *= 1'099'511'628'211ull;
+	}
+	return (size_t)hash;
+}
+
+void Glob_Matcher::set_group_patterns(Group* group, const std::vector<std::wstring_view>& group_patterns)
+{
+	std::erase_if(patterns, [group](const Pattern& pattern) { return pattern.group == group; });
+
+	for (std::wstring_view group_pattern : group_patterns)
+	{
+		Pattern pattern;
+
+		pattern.tokens.resize(group_pattern.size());
+		std::transform(group_pattern.begin(), group_pattern.end(), pattern.tokens.begin(), fold_process_name_char);
+		pattern.group = group;
+		patterns.push_back(std::move(pattern));
+	}
+
+	compile();
+}
+
+void Glob_Matcher::remove_group(Group* group)
+{
+	size_t nb_erased = std::erase_if(patterns, [group](const Pattern& pattern) { return pattern.group == group; });
+
+	if (nb_erased)
+		compile();
+}
+
+void Glob_Matcher::compile()
+{
+	// Character classes
+	memset(ascii_classes, 0, sizeof(ascii_classes));
+	other_classes.clear();
+	nb_classes = 1;
+
+	for (const Pattern& pattern : patterns)
+	{
+		for (wchar_t token : pattern.tokens)
+		{
+			if (token == L'*' || token == L'?' || get_class(token) != 0)
+				continue;
+
+			if ((uint32_t)token < 128)
+				ascii_classes[token] = nb_classes++;
+			else
+				other_classes.insert(std::make_pair(token, nb_classes++));
+		}
+	}
+
+	// NFA, each pattern of n tokens gives n + 1 states (the last one is final)
+	nfa_pattern.clear();
+	nfa_token.clear();
+	nfa_start_states.clear();
+
+	for (uint32_t pattern_index = 0; pattern_index < (uint32_t)patterns.size(); pattern_index++)
+	{
+		const Pattern& pattern = patterns[pattern_index];
+
+		nfa_start_states.push_back((uint32_t)nfa_token.size());
+
+		for (wchar_t token : pattern.tokens)
+		{
+			nfa_pattern.push_back(pattern_index);
+			nfa_token.push_back(token);
+		}
+		nfa_pattern.push_back(pattern_index);
+		nfa_token.push_back(L'\0');
+	}
+
+	// Now that tokens are known, expand leading stars of start states
+	{
+		std::vector<uint32_t> start_states;
+
+		for (uint32_t nfa_state : nfa_start_states)
+			add_closure(start_states, nfa_state);
+		nfa_start_states = std::move(start_states);
+	}
+
+	flush_dfa();
+}
+
+void Glob_Matcher::add_closure(std::vector<uint32_t>& nfa_states, uint32_t nfa_state) const
+{
+	nfa_states.push_back(nfa_state);
+	while (nfa_state < nfa_token.size() && nfa_token[nfa_state] == L'*')
+		nfa_states.push_back(++nfa_state); // A star can match an empty sequence
+}
+
+void Glob_Matcher::flush_dfa()
+{
+	dfa_states.clear();
+	dfa_transitions.clear();
+	dfa_states_by_set.clear();
+
+	std::vector<uint32_t> nfa_states;
+
+	get_state(nfa_states); // dead_state
+
+	nfa_states = nfa_start_states;
+	std::sort(nfa_states.begin(), nfa_states.end());
+	nfa_states.erase(std::unique(nfa_states.begin(), nfa_states.end()), nfa_states.end());
+	start_state = get_state(nfa_states);
+}
+
+uint32_t Glob_Matcher::get_state(std::vector<uint32_t>& nfa_states)
+{
+	auto it = dfa_states_by_set.find(nfa_states);
+	if (it != dfa_states_by_set.end())
+		return it->second;
+
+	uint32_t	state = (uint32_t)dfa_states.size();
+	Dfa_State	dfa_state;
+
+	it = dfa_states_by_set.insert(std::make_pair(std::move(nfa_states), state)).first;
+	dfa_state.nfa_states = &it->first;
+	for (uint32_t nfa_state : it->first)
+	{
+		if (nfa_token[nfa_state] != L'\0')
+			continue;
+
+		Group* group = patterns[nfa_pattern[nfa_state]].group;
+		if (std::find(dfa_state.accepted_groups.begin(), dfa_state.accepted_groups.end(), group) == dfa_state.accepted_groups.end())
+			dfa_state.accepted_groups.push_back(group);
+	}
+	dfa_states.push_back(std::move(dfa_state));
+	dfa_transitions.resize(dfa_transitions.size() + nb_classes, unknown_transition);
+
+	return state;
+}
+
+uint32_t Glob_Matcher::step(uint32_t state, wchar_t folded_char, uint16_t char_class)
+{
+	if (dfa_states.size() >= maximum_nb_dfa_states)
+	{
+		// Pathological set of patterns, restart from scratch but keep the current state alive
+		std::vector<uint32_t> nfa_states = *dfa_states[state].nfa_states;
+
+		flush_dfa();
+		state = get_state(nfa_states);
+	}
+
+	std::vector<uint32_t> next_nfa_states;
+
+	for (uint32_t nfa_state : *dfa_states[state].nfa_states)
+	{
+		wchar_t token = nfa_token[nfa_state];
+
+		if (token == L'*')
+			add_closure(next_nfa_states, nfa_state);
+		else if (token == L'?' || (token != L'\0' && token == folded_char))
+			add_closure(next_nfa_states, nfa_state + 1);
+	}
+	std::sort(next_nfa_states.begin(), next_nfa_states.end());
+	next_nfa_states.erase(std::unique(next_nfa_states.begin(), next_nfa_states.end()), next_nfa_states.end());
+
+	uint32_t next_state = get_state(next_nfa_states);
+
+	// All characters of a class give the same transition
+	dfa_transitions[(size_t)state * nb_classes + char_class] = next_state;
+	return next_state;
+}
+
+const Group_List* Glob_Matcher::find(std::wstring_view process_name)
+{
+	if (patterns.empty())
+		return nullptr;
+
+	uint32_t state = start_state;
+
+	for (wchar_t c : process_name)
+	{
+		wchar_t		folded_char = fold_process_name_char(c);
+		uint16_t	char_class = get_class(folded_char);
+		uint32_t	next_state = dfa_transitions[(size_t)state * nb_classes + char_class];
+
+		if (next_state == unknown_transition)
+			next_state = step(state, folded_char, char_class);
+		if (next_state == dead_state)
+			return nullptr;
+		state = next_state;
+	}
+
+	if (dfa_states[state].accepted_groups.empty())
+		return nullptr;
+	return &dfa_states[state].accepted_groups;
+}
+
+// =============================================================================
+
+void Process_Index::clear()
+{
+	groups_by_name.clear();
+	glob_matcher.patterns.clear();
+	glob_matcher.compile();
+}
+
+void Process_Index::set_group_processes(Group* group, const std::unordered_set<std::wstring>& process_names)
+{
+	std::vector<std::wstring_view> patterns;
+
+	remove_group(group);
+	for (const std::wstring& process_name : process_names)
+	{
+		if (is_process_name_pattern(process_name))
+			patterns.push_back(process_name);
+		else
+			add(process_name, group);
+	}
+	glob_matcher.set_group_patterns(group, patterns);
+}
+
+void Process_Index::remove_group(Group* group)
+{
+	for (auto it = groups_by_name.begin(); it != groups_by_name.end();)
+	{
+		std::erase(it->second, group);
+		if (it->second.empty())
+			it = groups_by_name.erase(it);
+		else
+			++it;
+	}
+	glob_matcher.remove_group(group);
+}
+
+void Process_Index::add(std::wstring_view process_name, Group* group)
+{
+	auto it = groups_by_name.find(process_name);
+
+	if (it == groups_by_name.end())
+	{
+		Process_Name_Key key;
+
+		key.name.resize(process_name.size());
+		std::transform(process_name.begin(), process_name.end(), key.name.begin(), fold_process_name_char);
+		key.hash = hash_process_name(key.name);
+		it = groups_by_name.emplace(std::move(key), Group_List()).first;
+	}
+
+	if (std::find(it->second.begin(), it->second.end(), group) == it->second.end())
+		it->second.push_back(group);
+}
+
+const Group_List* Process_Index::find(std::wstring_view process_name)
+{
+	const Group_List* exact_groups = nullptr;
+
+	auto it = groups_by_name.find(process_name);
+	if (it != groups_by_name.end())
+		exact_groups = &it->second;
+
+	const Group_List* pattern_groups = glob_matcher.find(process_name);
+
+	if (pattern_groups == nullptr)
+		return exact_groups;
+	if (exact_groups == nullptr)
+		return pattern_groups;
+
+	matching_groups = *exact_groups;
+	for (Group* group : *pattern_groups)
+	{
+		if (std::find(matching_groups.begin(), matching_groups.end(), group) == matching_groups.end())
+			matching_groups.push_back(group);
+	}
+	return &matching_groups;
+}
+
+// =============================================================================
+
+uint32_t Process_Name_Interner::intern(std::wstring_view process_name)
+{
+	auto it = ids_by_name.find(process_name);
+	if (it != ids_by_name.end())
+		return it->second;
+
+	Process_Name_Key key;
+
+	key.name.resize(process_name.size());
+	std::transform(process_name.begin(), process_name.end(), key.name.begin(), fold_process_name_char);
+	key.hash = hash_process_name(key.name);
+	it = ids_by_name.emplace(std::move(key), (uint32_t)names.size()).first;
+	names.push_back(&it->first.name);
+	return it->second;
+}
+
+// =============================================================================
+
+bool match_glob(std::wstring_view folded_pattern, std::wstring_view text)
+{
+	// Greedy matching with backtracking on the last star only, which is enough for globs
+	size_t pattern_pos = 0;
+	size_t text_pos = 0;
+	size_t star_pattern_pos = std::wstring_view::npos;
+	size_t star_text_pos = 0;
+
+	while (text_pos < text.size())
+	{
+		if (pattern_pos < folded_pattern.size() && folded_pattern[pattern_pos] == L'*')
+		{
+			star_pattern_pos = pattern_pos++;
+			star_text_pos = text_pos;
+		}
+		else if (pattern_pos < folded_pattern.size()
+			&& (folded_pattern[pattern_pos] == L'?' || folded_pattern[pattern_pos] == fold_process_name_char(text[text_pos])))
+		{
+			pattern_pos++;
+			text_pos++;
+		}
+		else if (star_pattern_pos != std::wstring_view::npos)
+		{
+			pattern_pos = star_pattern_pos + 1;
+			text_pos = ++star_text_pos;
+		}
+		else
+			return false;
+	}
+
+	while (pattern_pos < folded_pattern.size() && folded_pattern[pattern_pos] == L'*')
+		pattern_pos++;
+	return pattern_pos == folded_pattern.size();
+}
+
+bool match_command_line_predicates(const std::vector<std::wstring>& predicates, std::wstring_view command_line)
+{
+	if (predicates.empty())
+		return true;
+
+	for (const std::wstring& predicate : predicates)
+	{
+		if (is_process_name_pattern(predicate))
+		{
+			if (match_glob(predicate, command_line))
+				return true;
+		}
+		else
+		{
+			auto it = std::search(command_line.begin(), command_line.end(), predicate.begin(), predicate.end(),
+				[](wchar_t a, wchar_t b) { return fold_process_name_char(a) == b; });
+
+			if (it != command_line.end() || predicate.empty())
+				return true;
+		}
+	}
+	return false;
+}
+
+void test_process_index()
+{
+	Process_Index index;
+	Group* group_a = (Group*)0x10;
+	Group* group_b = (Group*)0x20;
+	Group* group_c = (Group*)0x30;
+
+	index.clear();
+	index.set_group_processes(group_a, { L"cl.exe", L"Link.exe", L"link.exe" });
+	index.set_group_processes(group_b, { L"CL.EXE" });
+
+	assert(index.groups_by_name.size() == 2);
+	assert(index.find(L"cl.exe") && *index.find(L"cl.exe") == Group_List({ group_a, group_b }));
+	assert(index.find(L"Cl.Exe") && *index.find(L"Cl.Exe") == Group_List({ group_a, group_b }));
+	assert(index.find(L"LINK.EXE") && *index.find(L"LINK.EXE") == Group_List({ group_a }));
+	assert(index.find(L"cl") == nullptr);
+	assert(index.find(L"") == nullptr);
+
+	// Patterns
+	index.set_group_processes(group_c, { L"clang*", L"*-g++-12", L"link*.exe", L"?c.exe" });
+
+	assert(index.find(L"clang") && *index.find(L"clang") == Group_List({ group_c }));
+	assert(index.find(L"clang++.exe") && *index.find(L"clang++.exe") == Group_List({ group_c }));
+	assert(index.find(L"x86_64-linux-gnu-g++-12") && *index.find(L"x86_64-linux-gnu-g++-12") == Group_List({ group_c }));
+	assert(index.find(L"x86_64-linux-gnu-g++-11") == nullptr);
+	assert(index.find(L"LINK.EXE") && *index.find(L"LINK.EXE") == Group_List({ group_a, group_c }));
+	assert(index.find(L"link-lld.exe") && *index.find(L"link-lld.exe") == Group_List({ group_c }));
+	assert(index.find(L"link-lld.ex") == nullptr);
+	assert(index.find(L"rc.exe") && *index.find(L"rc.exe") == Group_List({ group_c }));
+	assert(index.find(L"cla") == nullptr);
+	assert(index.find(L"gcc") == nullptr);
+
+	// Incremental updates
+	index.set_group_processes(group_a, { L"cl*" });
+	assert(index.find(L"link.exe") && *index.find(L"link.exe") == Group_List({ group_c }));
+	assert(index.find(L"cl.exe") && *index.find(L"cl.exe") == Group_List({ group_b, group_a }));
+
+	index.remove_group(group_c);
+	assert(index.find(L"link.exe") == nullptr);
+	assert(index.find(L"clang.exe") && *index.find(L"clang.exe") == Group_List({ group_a }));
+
+	// Command line predicates
+	assert(match_glob(L"*", L""));
+	assert(match_glob(L"a*b*c", L"AxxBxxbC"));
+	assert(!match_glob(L"a*b?c", L"abc"));
+	assert(match_command_line_predicates({}, L"cl.exe /c main.cpp"));
+	assert(match_command_line_predicates({ L"/rebuild", L"--clean-first" }, L"cmake --build . --CLEAN-first"));
+	assert(!match_command_line_predicates({ L"/rebuild" }, L"msbuild /build"));
+	assert(match_command_line_predicates({ L"msbuild*/t:rebuild*" }, L"MSBuild.exe app.sln /t:Rebuild /m"));
+	assert(!match_command_line_predicates({ L"msbuild*/t:rebuild" }, L"MSBuild.exe app.sln /t:Rebuild /m"));
+
+	// Interning
+	Process_Name_Interner interner;
+	uint32_t cl_id = interner.intern(L"CL.exe");
+	assert(interner.intern(L"link.exe") != cl_id);
+	assert(interner.intern(L"cl.EXE") == cl_id);
+	assert(interner.get_name(cl_id) == L"cl.exe");
+}
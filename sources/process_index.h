@@ -0,0 +1,181 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+#include <cwctype>
+
+struct Group;
+
+// Process names are compared case insensitively (Windows executable names are case insensitive).
+// Keys are folded once when the index is built, names coming from the system are folded on the fly
+// during hashing and comparison, so a lookup never allocates.
+inline wchar_t fold_process_name_char(wchar_t c)
+{
+	if (c < 0x80)
+		return (c >= L'A' && c <= L'Z') ? c + (L'a' - L'A') : c;
+	return (wchar_t)std::towlower(c);
+}
+
+inline size_t hash_process_name(std::wstring_view name)
+{
+	// FNV-1a on folded characters
+	uint64_t hash = 14'695'981'039'346'656'037ull;
+
+	for (wchar_t c : name)
+	{
+		hash ^= (uint64_t)fold_process_name_char(c);
+		hash *= 1'099'511'628'211ull;
+	}
+	return (size_t)hash;
+}
+
+struct Process_Name_Key
+{
+	std::wstring	name; // Folded (lower case)
+	size_t			hash; // Precomputed hash_process_name(name)
+};
+
+struct Process_Name_Hash
+{
+	using is_transparent = void;
+
+	size_t operator()(const Process_Name_Key& key) const { return key.hash; }
+	size_t operator()(std::wstring_view name) const { return hash_process_name(name); }
+};
+
+struct Process_Name_Equal
+{
+	using is_transparent = void;
+
+	bool operator()(const Process_Name_Key& a, const Process_Name_Key& b) const
+	{
+		return a.hash == b.hash && a.name == b.name;
+	}
+
+	bool operator()(const Process_Name_Key& key, std::wstring_view name) const
+	{
+		if (key.name.size() != name.size())
+			return false;
+		for (size_t i = 0; i < name.size(); i++)
+		{
+			if (key.name[i] != fold_process_name_char(name[i]))
+				return false;
+		}
+		return true;
+	}
+
+	bool operator()(std::wstring_view name, const Process_Name_Key& key) const
+	{
+		return (*this)(key, name);
+	}
+};
+
+using Group_List = std::vector<Group*>;
+
+inline bool is_process_name_pattern(std::wstring_view process_name)
+{
+	return process_name.find_first_of(L"*?") != std::wstring_view::npos;
+}
+
+// Matches a process name against the glob patterns ('*' any sequence, '?' any character) of all groups
+// in a single pass over the name.
+// All patterns are compiled into one NFA (a state is a position in a pattern), which is lazily
+// converted into a DFA: DFA states (sets of NFA states) and their transitions are only created when
+// a name reaches them, so the table stays small even with hundreds of patterns and after warm up a
+// match is just one table lookup per character.
+// @Warning The DFA is built during find, calls should be serialized (editing_groups_critical_section)
+struct Glob_Matcher
+{
+	static constexpr uint32_t	dead_state = 0; // Empty set of NFA states, no pattern can match anymore
+	static constexpr uint32_t	unknown_transition = 0xffffffff;
+	static constexpr size_t		maximum_nb_dfa_states = 4096; // The cache is flushed when reached
+
+	struct Pattern
+	{
+		std::wstring	tokens; // Folded
+		Group*			group;
+	};
+
+	struct Nfa_States_Hash
+	{
+		size_t operator()(const std::vector<uint32_t>& nfa_states) const;
+	};
+
+	struct Dfa_State
+	{
+		const std::vector<uint32_t>*	nfa_states; // Sorted, key of dfa_states_by_set
+		Group_List						accepted_groups;
+	};
+
+	std::vector<Pattern>	patterns;
+
+	// NFA, recomputed by compile
+	std::vector<uint32_t>	nfa_pattern;	// Pattern index of each NFA state
+	std::vector<wchar_t>	nfa_token;		// Token to consume to leave the state, '\0' for final states
+	std::vector<uint32_t>	nfa_start_states;
+
+	// Characters are mapped to classes, all characters that don't appear in patterns share the class 0
+	uint16_t								ascii_classes[128];
+	std::unordered_map<wchar_t, uint16_t>	other_classes;
+	uint16_t								nb_classes = 1;
+
+	// Lazy DFA
+	std::vector<Dfa_State>													dfa_states;
+	std::vector<uint32_t>													dfa_transitions; // dfa_states.size() * nb_classes
+	std::unordered_map<std::vector<uint32_t>, uint32_t, Nfa_States_Hash>	dfa_states_by_set;
+	uint32_t																start_state = dead_state;
+
+	void				set_group_patterns(Group* group, const std::vector<std::wstring_view>& group_patterns);
+	void				remove_group(Group* group);
+	void				compile();
+	const Group_List*	find(std::wstring_view process_name); // @Warning Result is valid until the next call
+
+	uint16_t			get_class(wchar_t folded_char) const;
+	uint32_t			get_state(std::vector<uint32_t>& nfa_states);
+	uint32_t			step(uint32_t state, wchar_t folded_char, uint16_t char_class);
+	void				add_closure(std::vector<uint32_t>& nfa_states, uint32_t nfa_state) const;
+	void				flush_dfa();
+};
+
+// Index of all process names of all groups, a process name can be shared by many groups.
+// Exact names are resolved by a single hash probe, names with wildcards by the Glob_Matcher.
+// Updated per group each time the list of process names of a group change.
+// @Warning Should be accessed with editing_groups_critical_section locked
+struct Process_Index
+{
+	std::unordered_map<Process_Name_Key, Group_List, Process_Name_Hash, Process_Name_Equal> groups_by_name;
+	Glob_Matcher	glob_matcher;
+	Group_List		matching_groups; // Result buffer when a name is matched by exact names and patterns
+
+	void				clear();
+	void				set_group_processes(Group* group, const std::unordered_set<std::wstring>& process_names);
+	void				remove_group(Group* group);
+	const Group_List*	find(std::wstring_view process_name); // @Warning Result is valid until the next call
+
+	void				add(std::wstring_view process_name, Group* group);
+};
+
+// Give a small stable id to each (folded) process name, so tracking records don't have to copy names.
+// Ids are never released, there is only as many names as distinct tracked executables.
+// @Warning Should be accessed with editing_groups_critical_section locked
+struct Process_Name_Interner
+{
+	std::unordered_map<Process_Name_Key, uint32_t, Process_Name_Hash, Process_Name_Equal>	ids_by_name;
+	std::vector<const std::wstring*>														names; // Point to keys of ids_by_name
+
+	uint32_t			intern(std::wstring_view process_name); // Allocate only for the first occurrence of a name
+	const std::wstring&	get_name(uint32_t process_name_id) const { return *names[process_name_id]; }
+};
+
+// Predicates on the command line of a process, evaluated only when its name matched a group that
+// have some. A predicate with wildcards should match the whole command line, others are searched
+// as a sub-string. Predicates should be folded.
+bool match_glob(std::wstring_view folded_pattern, std::wstring_view text);
+bool match_command_line_predicates(const std::vector<std::wstring>& predicates, std::wstring_view command_line);
+
+void test_process_index();
@@ -0,0 +1,360 @@
+#include "records.h"
+
+#include "group.h"
+
+#include <fstream>
+#include <string_view>
+#include <system_error>
+
+#include <cassert>
+
+// Execution_Resources of version 2
+struct Execution_Resources_V2
+{
+	uint64_t start_time;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint32_t user_time_ms;
+	uint32_t kernel_time_ms;
+	uint32_t peak_memory_kb;
+};
+
+// Reads are checked against the size of the file, a corrupted count can't trigger a huge allocation
+struct Record_Reader
+{
+	std::ifstream	file;
+	uint64_t		remaining_size = 0;
+
+	bool read(void* data, uint64_t size)
+	{
+		if (size > remaining_size)
+			return false;
+		remaining_size -= size;
+		return (bool)file.read((char*)data, (std::streamsize)size);
+	}
+
+	template<typename Value>
+	bool read_value(Value& value)
+	{
+		return read(&value, sizeof(value));
+	}
+
+	template<typename Value>
+	bool read_array(std::vector<Value>& values)
+	{
+		uint32_t size;
+
+		if (!read_value(size) || size * sizeof(Value) > remaining_size)
+			return false;
+		values.resize(size);
+		return read(values.data(), size * sizeof(Value));
+	}
+
+	bool read_string(std::string& string)
+	{
+		uint32_t size;
+
+		if (!read_value(size) || size > remaining_size)
+			return false;
+		string.resize(size);
+		return read(string.data(), size);
+	}
+
+	// UTF-16 in the file
+	bool read_wstring(std::wstring& string)
+	{
+		std::vector<char16_t> utf16;
+
+		if (!read_array(utf16))
+			return false;
+
+		string.clear();
+		string.reserve(utf16.size());
+		for (size_t i = 0; i < utf16.size(); i++)
+		{
+			uint32_t code_point = utf16[i];
+
+			if constexpr (sizeof(wchar_t) == sizeof(char16_t))
+				string.push_back((wchar_t)code_point);
+			else
+			{
+				// Surrogate pair
+				if (code_point >= 0xd800 && code_point < 0xdc00 && i + 1 < utf16.size() && utf16[i + 1] >= 0xdc00 && utf16[i + 1] < 0xe000)
+					code_point = 0x10000 + ((code_point - 0xd800) << 10) + (utf16[++i] - 0xdc00);
+				string.push_back((wchar_t)code_point);
+			}
+		}
+		return true;
+	}
+};
+
+struct Record_Writer
+{
+	std::ofstream			file;
+	std::u16string			utf16; // Reused by write_wstring
+
+	void write(const void* data, uint64_t size)
+	{
+		file.write((const char*)data, (std::streamsize)size);
+	}
+
+	template<typename Value>
+	void write_value(const Value& value)
+	{
+		write(&value, sizeof(value));
+	}
+
+	template<typename Value>
+	void write_array(const std::vector<Value>& values)
+	{
+		uint32_t size = (uint32_t)values.size();
+
+		write_value(size);
+		write(values.data(), size * sizeof(Value));
+	}
+
+	void write_string(std::string_view string)
+	{
+		uint32_t size = (uint32_t)string.size();
+
+		write_value(size);
+		write(string.data(), size);
+	}
+
+	void write_wstring(std::wstring_view string)
+	{
+		utf16.clear();
+		for (wchar_t c : string)
+		{
+			uint32_t code_point = (uint32_t)c;
+
+			if (code_point >= 0x10000) // Only with a 32 bits wchar_t
+			{
+				utf16.push_back((char16_t)(0xd800 + ((code_point - 0x10000) >> 10)));
+				utf16.push_back((char16_t)(0xdc00 + ((code_point - 0x10000) & 0x3ff)));
+			}
+			else
+				utf16.push_back((char16_t)code_point);
+		}
+
+		uint32_t size = (uint32_t)utf16.size();
+
+		write_value(size);
+		write(utf16.data(), size * sizeof(char16_t));
+	}
+};
+
+static bool read_group(Record_Reader& reader, uint32_t file_format_version, Group* group)
+{
+	uint32_t nb_process_names;
+
+	if (!reader.read_string(group->name) || !reader.read_value(nb_process_names))
+		return false;
+	for (uint32_t process_name_index = 0; process_name_index < nb_process_names; process_name_index++)
+	{
+		std::wstring process_name;
+
+		if (!reader.read_wstring(process_name))
+			return false;
+		group->proccess_names.insert(std::move(process_name));
+	}
+
+	if (file_format_version >= 1)
+	{
+		uint32_t nb_predicates;
+
+		if (!reader.read_value(nb_predicates) || nb_predicates > reader.remaining_size)
+			return false;
+		group->command_line_predicates.resize(nb_predicates);
+		for (std::wstring& predicate : group->command_line_predicates)
+		{
+			if (!reader.read_wstring(predicate))
+				return false;
+		}
+	}
+
+	if (file_format_version >= 4)
+	{
+		if (!reader.read_value(group->freeze_cpu_threshold_percent) || !reader.read_value(group->freeze_minimum_duration_ms))
+			return false;
+	}
+
+	if (file_format_version >= 5)
+	{
+		if (!reader.read_value(group->track_process_tree))
+			return false;
+	}
+
+	if (!reader.read_array(group->merged_executions))
+		return false;
+
+	if (file_format_version >= 3)
+	{
+		uint32_t nb_executables;
+
+		if (!reader.read_array(group->resources) || !reader.read_value(nb_executables) || nb_executables > reader.remaining_size)
+			return false;
+		group->executables.resize(nb_executables);
+		for (std::wstring& executable : group->executables)
+		{
+			if (!reader.read_wstring(executable))
+				return false;
+		}
+	}
+	else if (file_format_version == 2)
+	{
+		// No end time and executable, executions are considered as instantaneous
+		std::vector<Execution_Resources_V2> resources;
+
+		if (!reader.read_array(resources))
+			return false;
+
+		group->executables.push_back(L"?");
+		group->resources.reserve(resources.size());
+		for (const Execution_Resources_V2& resources_v2 : resources)
+		{
+			group->resources.push_back({ resources_v2.start_time, resources_v2.start_time,
+				resources_v2.read_bytes, resources_v2.write_bytes,
+				resources_v2.user_time_ms, resources_v2.kernel_time_ms, resources_v2.peak_memory_kb, 0 });
+		}
+	}
+	return true;
+}
+
+bool load_records(const std::filesystem::path& path, Records& records)
+{
+	Record_Reader	reader;
+	std::error_code	error;
+
+	reader.remaining_size = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	reader.file.open(path, std::ios::binary);
+
+	char		magic_number[5];
+	uint32_t	file_format_version;
+	uint32_t	nb_groups;
+
+	if (!reader.file || !reader.read_value(magic_number) || std::string_view(magic_number, 5) != "DTIME"
+		|| !reader.read_value(file_format_version) || file_format_version > record_format_version || !reader.read_value(nb_groups))
+		return false;
+
+	bool is_valid = true;
+
+	for (uint32_t group_index = 0; group_index < nb_groups && is_valid; group_index++)
+	{
+		Group* group = new Group();
+
+		records.groups.push_back(group);
+		is_valid = read_group(reader, file_format_version, group);
+		if (is_valid)
+		{
+			// Merges only update it with new executions, the history is swept here once
+			group->concurrency.update(group->resources);
+			update_group_memory_bytes(group);
+		}
+	}
+
+	if (!is_valid || !reader.read_string(records.current_group_name))
+	{
+		for (Group* group : records.groups)
+			delete group;
+		records = Records();
+		return false;
+	}
+	return true;
+}
+
+bool save_records(const std::filesystem::path& path, const std::vector<Group*>& groups, const std::string& current_group_name)
+{
+	std::filesystem::path	temporary_path = path;
+	Record_Writer			writer;
+
+	temporary_path += ".tmp";
+	writer.file.open(temporary_path, std::ios::binary | std::ios::trunc);
+	if (!writer.file)
+		return false;
+
+	writer.write("DTIME", 5);
+	writer.write_value(record_format_version);
+	writer.write_value((uint32_t)groups.size());
+	for (Group* group : groups)
+	{
+		writer.write_string(group->name);
+
+		writer.write_value((uint32_t)group->proccess_names.size());
+		for (const auto& process_name : group->proccess_names)
+			writer.write_wstring(process_name);
+
+		writer.write_value((uint32_t)group->command_line_predicates.size());
+		for (const auto& predicate : group->command_line_predicates)
+			writer.write_wstring(predicate);
+
+		writer.write_value(group->freeze_cpu_threshold_percent);
+		writer.write_value(group->freeze_minimum_duration_ms);
+		writer.write_value(group->track_process_tree);
+
+		std::lock_guard lock(group->executions_mutex);
+
+		writer.write_array(group->merged_executions);
+		writer.write_array(group->resources);
+		writer.write_value((uint32_t)group->executables.size());
+		for (const auto& executable : group->executables)
+			writer.write_wstring(executable);
+	}
+
+	// Selected group name
+	writer.write_string(current_group_name);
+
+	writer.file.close();
+	if (!writer.file)
+		return false;
+
+	std::error_code error;
+
+	std::filesystem::rename(temporary_path, path, error);
+	return !error;
+}
+
+void test_records()
+{
+	std::filesystem::path	path = std::filesystem::temp_directory_path() / "dear_time_test_records.dat";
+	Records					records;
+	Group*					group = new Group();
+
+	group->name = "Build";
+	group->proccess_names = { L"cl.exe", L"cl\u00e9*.exe", L"\U0001F600.exe" }; // Outside of the BMP with a 32 bits wchar_t
+	group->command_line_predicates = { L"/c" };
+	group->freeze_cpu_threshold_percent = 50;
+	group->track_process_tree = true;
+	group->merged_executions = { { 100, 200 }, { 300, 400 } };
+	group->resources = { { 100, 200, 1, 2, 3, 4, 5, 0 }, { 300, 400, 6, 7, 8, 9, 10, 1 } };
+	group->executables = { L"cl.exe", L"\U0001F600.exe" };
+
+	assert(!load_records(path / "missing", records));
+	assert(save_records(path, { group }, "Build"));
+	assert(!std::filesystem::exists(path.string() + ".tmp"));
+	assert(load_records(path, records));
+	assert(records.groups.size() == 1 && records.current_group_name == "Build");
+
+	Group* loaded_group = records.groups[0];
+
+	assert(loaded_group->name == group->name);
+	assert(loaded_group->proccess_names == group->proccess_names);
+	assert(loaded_group->command_line_predicates == group->command_line_predicates);
+	assert(loaded_group->freeze_cpu_threshold_percent == 50 && loaded_group->freeze_minimum_duration_ms == 2000);
+	assert(loaded_group->track_process_tree);
+	assert(loaded_group->merged_executions == group->merged_executions);
+	assert(loaded_group->resources.size() == 2 && loaded_group->resources[1].peak_memory_kb == 10 && loaded_group->resources[1].executable_index == 1);
+	assert(loaded_group->concurrency.step_times == std::vector<uint64_t>({ 100, 200, 300, 400 }) && loaded_group->concurrency.maximum_concurrency == 1);
+	assert(loaded_group->executables == group->executables);
+
+	// A truncated file is rejected without leaking the groups read so far
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+	Records truncated_records;
+	assert(!load_records(path, truncated_records) && truncated_records.groups.empty());
+
+	std::filesystem::remove(path);
+	delete loaded_group;
+	delete group;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+struct Group;
+
+// Record file: settings and history of all groups, and the selected group of the UI.
+// Process names are stored in UTF-16 whatever the size of wchar_t, so records written by the daemon on
+// Linux can be opened by the application.
+
+constexpr uint32_t record_format_version = 5; // 1: command line predicates, 2: execution resources, 3: end time and executable of executions, 4: freeze detection, 5: process trees
+
+struct Records
+{
+	std::vector<Group*>	groups; // Allocated by load_records, ids aren't set
+	std::string			current_group_name;
+};
+
+// Return false if the file doesn't exist or is invalid, records are left empty then
+bool load_records(const std::filesystem::path& path, Records& records);
+
+// Written to a temporary file which then replaces the previous one, a crash during a backup keeps the
+// previous records
+// @Warning Groups shouldn't be edited meanwhile, executions are read under executions_mutex
+bool save_records(const std::filesystem::path& path, const std::vector<Group*>& groups, const std::string& current_group_name);
+
+void test_records();
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#   define SPIN_LOCK_PAUSE() _mm_pause()
+#elif defined(__x86_64__) || defined(__i386__)
+#   define SPIN_LOCK_PAUSE() __builtin_ia32_pause()
+#else
+#   define SPIN_LOCK_PAUSE() ((void)0)
+#endif
+
+// Lock for very short critical sections (a few memory accesses), cheaper than a CRITICAL_SECTION
+// when contention is low. Spin on a relaxed load to not bounce the cache line, then yield.
+struct Spin_Lock
+{
+	std::atomic<bool> locked = false;
+
+	void lock()
+	{
+		for (;;)
+		{
+			if (!locked.exchange(true, std::memory_order_acquire))
+				return;
+
+			for (uint32_t nb_spins = 0; locked.load(std::memory_order_relaxed); nb_spins++)
+			{
+				if (nb_spins < 64)
+					SPIN_LOCK_PAUSE();
+				else
+					std::this_thread::yield();
+			}
+		}
+	}
+
+	bool try_lock()
+	{
+		return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+	}
+
+	void unlock()
+	{
+		locked.store(false, std::memory_order_release);
+	}
+};
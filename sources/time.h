@@ -1,7 +1,8 @@
 #pragma once
 
+#include <chrono>
 #include <format>
-#include <string>
+#include <string_view>
 
 #include <cstdint>
 
@@ -13,6 +14,16 @@ constexpr uint64_t hour_duration = 60 * 60;
 constexpr uint64_t minute_duration = 60;
 constexpr uint64_t second_duration = 1;
 
+constexpr uint64_t WINDOWS_TICK = 10'000'000; // Windows ticks (100 ns) per second
+constexpr uint64_t SEC_TO_UNIX_EPOCH = 11'644'473'600LL; // From January 1, 1601 to January 1, 1970
+
+// System time in Windows ticks, as the FILETIME dates given by the OS
+inline uint64_t get_current_windows_ticks()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return SEC_TO_UNIX_EPOCH * WINDOWS_TICK + (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() / 100;
+}
+
 constexpr double years(uint64_t s)
 {
     return s / year_duration;
@@ -59,7 +70,7 @@ constexpr uint32_t time_unit_divisors[] = {
     (uint32_t)year_duration
 };
 
-static std::string time_unit_labels[] = {
+constexpr std::string_view time_unit_labels[] = {
     "seconds",
     "minutes",
     "hours",
@@ -69,7 +80,7 @@ static std::string time_unit_labels[] = {
     "years"
 };
 
-static std::string time_unit_short_labels[] = {
+constexpr std::string_view time_unit_short_labels[] = {
     "s",
     "min",
     "hours",
@@ -102,19 +113,23 @@ constexpr uint32_t get_time_unit_divisor(Time_Unit unit)
     return time_unit_divisors[(size_t)unit];
 }
 
-constexpr std::string get_time_unit_label(Time_Unit unit)
+constexpr std::string_view get_time_unit_label(Time_Unit unit)
 {
     return time_unit_labels[(size_t)unit];
 }
 
-constexpr std::string get_time_unit_short_label(Time_Unit unit)
+constexpr std::string_view get_time_unit_short_label(Time_Unit unit)
 {
     return time_unit_short_labels[(size_t)unit];
 }
 
-inline std::string format_duration(uint64_t s)
+// Write the duration with its best unit in buffer (always null terminated, truncated if too small),
+// there is no allocation
+inline std::string_view format_duration_to(char* buffer, size_t buffer_size, uint64_t s)
 {
     Time_Unit unit = get_time_unit(s);
+    auto result = std::format_to_n(buffer, buffer_size - 1, "{:.1f} {}", s / (double)get_time_unit_divisor(unit), get_time_unit_short_label(unit));
 
-    return std::format("{:.1f} {}", s / (double)get_time_unit_divisor(unit), get_time_unit_short_label(unit));
+    *result.out = '\0';
+    return std::string_view(buffer, result.out);
 }
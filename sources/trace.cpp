@@ -0,0 +1,198 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cassert>
+#include <cstdio>
+
+static_assert((trace_buffer_capacity & (trace_buffer_capacity - 1)) == 0, "trace_buffer_capacity should be a power of 2");
+
+// Fields are relaxed atomics, a save can read a slot while its thread overwrites it (torn events are
+// detected with nb_events and dropped)
+struct Trace_Event
+{
+	std::atomic<const char*>	name;
+	std::atomic<uint64_t>		start_ns;
+	std::atomic<uint64_t>		end_ns;
+};
+
+// Written by its thread only
+struct Trace_Buffer
+{
+	std::atomic<uint64_t>		nb_events = 0; // Since the start, the last trace_buffer_capacity ones are in events
+	std::atomic<const char*>	thread_name = nullptr;
+	uint32_t					thread_index = 0;
+	Trace_Event					events[trace_buffer_capacity];
+};
+
+// Buffers are never freed, threads of the Windows thread pool (termination callbacks) are reused so their
+// number stays small
+static std::mutex					buffers_mutex; // Registration of threads and saves only
+static std::vector<Trace_Buffer*>	buffers;
+static thread_local Trace_Buffer*	thread_buffer = nullptr;
+
+static Trace_Buffer* get_thread_buffer()
+{
+	if (!thread_buffer)
+	{
+		Trace_Buffer* buffer = new Trace_Buffer();
+
+		std::lock_guard lock(buffers_mutex);
+		buffer->thread_index = (uint32_t)buffers.size();
+		buffers.push_back(buffer);
+		thread_buffer = buffer;
+	}
+	return thread_buffer;
+}
+
+void record_trace_event(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+	Trace_Buffer*	buffer = get_thread_buffer();
+	uint64_t		index = buffer->nb_events.load(std::memory_order_relaxed);
+	Trace_Event&	event = buffer->events[index & (trace_buffer_capacity - 1)];
+
+	// A save that sees one of the following stores also sees that the slot of event index is being written
+	std::atomic_thread_fence(std::memory_order_release);
+	event.name.store(name, std::memory_order_relaxed);
+	event.start_ns.store(start_ns, std::memory_order_relaxed);
+	event.end_ns.store(end_ns, std::memory_order_relaxed);
+	buffer->nb_events.store(index + 1, std::memory_order_release);
+}
+
+void set_trace_thread_name(const char* name)
+{
+	get_thread_buffer()->thread_name.store(name, std::memory_order_relaxed);
+}
+
+struct Saved_Trace_Event
+{
+	const char*	name;
+	uint64_t	start_ns;
+	uint64_t	end_ns;
+};
+
+// Copy of the events of a buffer that weren't overwritten during the copy
+static void copy_trace_events(const Trace_Buffer* buffer, std::vector<Saved_Trace_Event>& events)
+{
+	uint64_t end = buffer->nb_events.load(std::memory_order_acquire);
+	uint64_t begin = end > trace_buffer_capacity ? end - trace_buffer_capacity : 0;
+	size_t   first_copied = events.size();
+
+	for (uint64_t i = begin; i < end; i++)
+	{
+		const Trace_Event& event = buffer->events[i & (trace_buffer_capacity - 1)];
+
+		events.push_back({ event.name.load(std::memory_order_relaxed), event.start_ns.load(std::memory_order_relaxed), event.end_ns.load(std::memory_order_relaxed) });
+	}
+
+	// The slot of event new_end may be being written, events in the same slot or older are dropped (the
+	// oldest event of a full buffer is never saved)
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t new_end = buffer->nb_events.load(std::memory_order_relaxed);
+
+	if (new_end >= begin + trace_buffer_capacity)
+	{
+		size_t nb_dropped = (size_t)std::min(new_end - (begin + trace_buffer_capacity) + 1, end - begin);
+
+		events.erase(events.begin() + first_copied, events.begin() + first_copied + nb_dropped);
+	}
+}
+
+bool save_chrome_trace(const std::filesystem::path& path)
+{
+	std::vector<Trace_Buffer*>		saved_buffers;
+	std::vector<Saved_Trace_Event>	events;
+	std::ofstream					file(path, std::ios::binary | std::ios::trunc);
+	char							line[512];
+	uint64_t						origin_ns = UINT64_MAX;
+
+	if (!file)
+		return false;
+
+	{
+		std::lock_guard lock(buffers_mutex);
+		saved_buffers = buffers;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Dear Time\"}}";
+
+	std::vector<size_t> thread_ends; // End of the events of each buffer
+
+	for (const Trace_Buffer* buffer : saved_buffers)
+	{
+		copy_trace_events(buffer, events);
+		thread_ends.push_back(events.size());
+	}
+	for (const Saved_Trace_Event& event : events)
+		origin_ns = std::min(origin_ns, event.start_ns);
+
+	size_t event_index = 0;
+
+	for (size_t buffer_index = 0; buffer_index < saved_buffers.size(); buffer_index++)
+	{
+		const Trace_Buffer*	buffer = saved_buffers[buffer_index];
+		const char*			thread_name = buffer->thread_name.load(std::memory_order_relaxed);
+		uint32_t			tid = buffer->thread_index + 1;
+
+		if (thread_name)
+		{
+			snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", tid, thread_name);
+			file << line;
+		}
+
+		// Complete events ("X"), times are in microseconds
+		for (; event_index < thread_ends[buffer_index]; event_index++)
+		{
+			const Saved_Trace_Event& event = events[event_index];
+
+			snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, tid, (event.start_ns - origin_ns) / 1000.0, (event.end_ns - event.start_ns) / 1000.0);
+			file << line;
+		}
+	}
+
+	file << "\n]}\n";
+	file.close();
+	return (bool)file;
+}
+
+void test_trace()
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "dear_time_test_trace.json";
+
+	// The ring buffer keeps the last events
+	std::thread thread([]() {
+		set_trace_thread_name("Test thread");
+		for (uint64_t i = 0; i < trace_buffer_capacity + 10; i++)
+			record_trace_event(i < 10 ? "test_overwritten_zone" : "test_zone", 1000 * i, 1000 * i + 500);
+	});
+	thread.join();
+
+	{
+		Trace_Zone zone("test_scoped_zone");
+	}
+
+	assert(save_chrome_trace(path));
+
+	std::ifstream	file(path);
+	std::string		content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	size_t			nb_zones = 0;
+
+	for (size_t position = content.find("\"test_zone\""); position != std::string::npos; position = content.find("\"test_zone\"", position + 1))
+		nb_zones++;
+	assert(nb_zones == trace_buffer_capacity - 1); // The oldest slot may be being rewritten
+	assert(content.find("test_overwritten_zone") == std::string::npos);
+	assert(content.find("\"test_scoped_zone\"") != std::string::npos);
+	assert(content.find("\"Test thread\"") != std::string::npos);
+	assert(content.rfind("]}\n") == content.size() - 3);
+
+	file.close();
+	std::filesystem::remove(path);
+}
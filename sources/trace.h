@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+// Tracing zones: the duration of a scope is recorded in a ring buffer of its thread, and the last events
+// of all threads can be saved as a Chrome trace (JSON, opened by chrome://tracing or Perfetto) at any time.
+// Zones are only compiled with DEAR_TIME_TRACING, otherwise TRACE_ZONE expands to nothing.
+// A zone costs two reads of the clock and a few relaxed stores, without lock nor allocation (except the
+// buffer of a thread, allocated with its first zone).
+
+constexpr size_t trace_buffer_capacity = 16384; // Events per thread, power of 2
+
+inline uint64_t get_trace_time_ns()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// @Warning Names should be string literals without quotes, only their pointer is recorded
+void	record_trace_event(const char* name, uint64_t start_ns, uint64_t end_ns);
+void	set_trace_thread_name(const char* name);
+
+// Threads keep recording meanwhile, events overwritten during the copy are dropped
+bool	save_chrome_trace(const std::filesystem::path& path);
+
+struct Trace_Zone
+{
+	const char*	name;
+	uint64_t	start_ns;
+
+	Trace_Zone(const char* name) : name(name), start_ns(get_trace_time_ns()) {}
+	~Trace_Zone() { record_trace_event(name, start_ns, get_trace_time_ns()); }
+};
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+
+#if defined(DEAR_TIME_TRACING)
+#   define TRACE_ZONE(name) Trace_Zone TRACE_CONCATENATE(trace_zone_, __LINE__)(name)
+#   define TRACE_THREAD_NAME(name) set_trace_thread_name(name)
+#else
+#   define TRACE_ZONE(name) ((void)0)
+#   define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+void test_trace();
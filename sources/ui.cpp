@@ -1,7 +1,13 @@
 #include "ui.h"
 
 #include "application.h"
+#include "capture_lag.h"
+#include "diagnostics.h"
+#include "frame_arena.h"
 #include "time.h"
+#include "trace.h"
+#include "view.h"
+#include "wmi.h"
 
 #include <imgui/imgui.h>
 #include <implot/implot.h>
@@ -22,14 +28,10 @@ constexpr size_t group_name_maximum_length = 32;
 constexpr size_t processes_string_maximum_length = 4096;
 
 // Forward declaration of helpers
-static void     insert_merge_entry(std::vector<RunningEntry>& merged_entries, const RunningEntry& entry);
-static void     merge_durations(const std::vector<double>& durations, uint64_t period_duration, std::vector<double>& result);
-static uint64_t get_optimal_period_duration(double range_start_s, double range_end_s);
-static void     generate_time_data(const std::string& group_name);
-static uint64_t WindowsTickToUnixSeconds(uint64_t windowsTicks);
-static void     draw_graph(Group* group);
+static void     draw_graph(Group* group, const View_Frame& frame);
 static void     duration_formmatter(double value, char* buff, int size, void* user_data);
 static void     ui_groups_dialog();
+static void     ui_diagnostics_window();
 
 inline float maximum_group_name_ui_width()
 {
@@ -37,9 +39,87 @@ inline float maximum_group_name_ui_width()
     return ImGui::CalcTextSize(wider_chars).x + ImGui::GetStyle().FramePadding.x * 2.0f;
 }
 
-inline double floor_at_unit(double value, uint64_t unit)
+// Temporaries of the UI (formatted texts,...), released at the start of the next frame
+static Frame_Arena frame_arena;
+
+// Visible range of the graph, restored when the ImPlot context is created again (background mode)
+static double graph_range_start = 0.0;
+static double graph_range_end = 0.0;
+
+// Regions of the last frame where moving the mouse can change the output (hover highlights, mouse position
+// of the plot,...), a move elsewhere doesn't need a frame while nothing is hovered, active or open
+struct Interactive_Region
+{
+    ImVec2 min;
+    ImVec2 max;
+};
+
+constexpr size_t maximum_nb_interactive_regions = 8;
+
+static Interactive_Region   interactive_regions[maximum_nb_interactive_regions];
+static size_t               nb_interactive_regions = 0;
+static bool                 is_interacting = false; // An item was hovered or active, or a popup was open
+static bool                 was_mouse_in_region = false; // Hover states are cleared by the frame after leaving a region
+
+static void add_interactive_region(ImVec2 min, ImVec2 max)
+{
+    if (nb_interactive_regions < maximum_nb_interactive_regions)
+        interactive_regions[nb_interactive_regions++] = { min, max };
+}
+
+bool ui_is_mouse_move_relevant(float x, float y)
+{
+    bool is_in_region = false;
+
+    for (size_t i = 0; i < nb_interactive_regions && !is_in_region; i++)
+    {
+        const Interactive_Region& region = interactive_regions[i];
+
+        is_in_region = x >= region.min.x && y >= region.min.y && x < region.max.x && y < region.max.y;
+    }
+
+    bool is_relevant = is_interacting || is_in_region || was_mouse_in_region;
+
+    was_mouse_in_region = is_in_region;
+    return is_relevant;
+}
+
+constexpr size_t frame_arena_capacity = 64 * 1024;
+constexpr size_t formatted_value_maximum_length = 32;
+
+// Texts below are allocated in the frame arena, they stay valid until the next frame
+static const char* frame_format_duration(uint64_t s)
+{
+    char* buffer = frame_arena.allocate_string(formatted_value_maximum_length);
+
+    format_duration_to(buffer, formatted_value_maximum_length, s);
+    return buffer;
+}
+
+static const char* frame_format_bytes(uint64_t bytes)
 {
-    return value - ((uint64_t)value % unit);
+    constexpr const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    double value = (double)bytes;
+    size_t unit = 0;
+    char* buffer = frame_arena.allocate_string(formatted_value_maximum_length);
+
+    while (value >= 1024.0 && unit + 1 < std::size(units))
+    {
+        value /= 1024.0;
+        unit++;
+    }
+    *std::format_to_n(buffer, formatted_value_maximum_length - 1, "{:.1f} {}", value, units[unit]).out = '\0';
+    return buffer;
+}
+
+static const char* frame_to_utf8(const std::wstring& string)
+{
+    int size = WideCharToMultiByte(CP_UTF8, 0, string.data(), (int)string.size(), NULL, 0, NULL, NULL);
+    char* buffer = frame_arena.allocate_string((size_t)size + 1);
+
+    WideCharToMultiByte(CP_UTF8, 0, string.data(), (int)string.size(), buffer, size, NULL, NULL);
+    buffer[size] = '\0';
+    return buffer;
 }
 
 void initialize_ui()
@@ -58,17 +138,35 @@ void initialize_ui()
     ImPlot::GetStyle().UseISO8601 = true;
     ImPlot::GetStyle().Use24HourClock = true;
     ImPlot::GetStyle().FitPadding = ImVec2(0.0f, 0.1f);
+
+    frame_arena.initialize(frame_arena_capacity);
+}
+
+void terminate_ui()
+{
+    frame_arena.terminate();
+    nb_interactive_regions = 0;
+    is_interacting = false;
+    was_mouse_in_region = false;
 }
 
 void ui_frame()
 {
     Group* group = g_dear_time.empty_group;
-    
-    EnterCriticalSection(&g_dear_time.editing_groups_critical_section);
+
+    frame_arena.reset();
+    nb_interactive_regions = 0;
+
+    enter_editing_groups_critical_section();
 
     if (g_dear_time.current_group_name.size())
         group = get_tracking_group(g_dear_time.current_group_name);
 
+    // Prepared by the view thread, until the frame of a newly selected group is ready nothing is shown
+    static const View_Frame empty_frame;
+    const View_Frame& view_frame = get_view_frame();
+    const View_Frame& frame = view_frame.group_id == group->id ? view_frame : empty_frame;
+
     const auto& io = ImGui::GetIO();
 
     ImGui::SetNextWindowSize(io.DisplaySize);
@@ -76,20 +174,27 @@ void ui_frame()
     ImGui::Begin("Graphs", NULL,
         ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoTitleBar |
         ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
-        ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoDecoration);
+        ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoDecoration |
+        ImGuiWindowFlags_NoBringToFrontOnFocus); // Stay behind the diagnostics window
 
+    add_interactive_region(ImVec2(0.0f, 0.0f), ImVec2(io.DisplaySize.x, ImGui::GetFrameHeight())); // Menu bar
     if (ImGui::BeginMenuBar())
     {
         if (ImGui::BeginMenu("File"))
         {
             //if (ImGui::MenuItem("Open..", "Ctrl+O")) { /* Do stuff */ }
             //if (ImGui::MenuItem("Save", "Ctrl+S")) { /* Do stuff */ }
+#if defined(DEAR_TIME_TRACING)
+            // Last events of all threads, to open in chrome://tracing or Perfetto
+            if (ImGui::MenuItem("Save trace")) { save_chrome_trace(g_dear_time.app_data_folder_path + L"\\trace.json"); }
+#endif
             if (ImGui::MenuItem("Quit", "Ctrl+W")) { g_dear_time.done = true; }
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Settings"))
         {
             if (ImGui::MenuItem("Groups", "Ctrl+G")) { g_dear_time.groups_dialog = true; }
+            ImGui::MenuItem("Diagnostics", NULL, &g_dear_time.diagnostics_window);
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
@@ -108,7 +213,15 @@ void ui_frame()
     if (graph_width >= 1.0f)
     {
         ImGui::BeginChild("Graph frame", ImVec2(graph_width, -1.0f));
-        draw_graph(group);
+        add_interactive_region(ImGui::GetWindowPos(), ImVec2(ImGui::GetWindowPos().x + ImGui::GetWindowSize().x, ImGui::GetWindowPos().y + ImGui::GetWindowSize().y));
+        {
+#if defined(_DEBUG)
+            No_Heap_Allocation_Scope no_heap_allocation;
+#endif
+            Diagnostic_Scope plot(Diagnostic_Series::plot);
+
+            draw_graph(group, frame);
+        }
         ImGui::EndChild();
 
         ImGui::SameLine(std::max(io.DisplaySize.x - stats_panel_width, ImGui::GetStyle().ItemSpacing.x));
@@ -117,9 +230,11 @@ void ui_frame()
     ImGui::BeginGroup();
     {
         ImGui::SetNextItemWidth(maximum_group_name_ui_width());
-        if (ImGui::BeginCombo("###Group", g_dear_time.current_group_name.c_str()))
+        bool is_group_combo_open = ImGui::BeginCombo("###Group", g_dear_time.current_group_name.c_str());
+        add_interactive_region(ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
+        if (is_group_combo_open)
         {
-            for (auto it : g_dear_time.groups)
+            for (const auto& it : g_dear_time.groups)
             {
                 bool is_selected = (g_dear_time.current_group_name == it.second->name);
 
@@ -133,16 +248,45 @@ void ui_frame()
         }
         ImGui::NewLine();
 
+#if defined(_DEBUG)
+        // Stats are formatted in the frame arena
+        No_Heap_Allocation_Scope no_heap_allocation;
+#endif
+
         // @Warning I add a little epsilon to be able to get 1.0 year and 1.0 month (instead of 4.3 weeks (which is ugly))
         // @TODO Investigate to find the source of this issue, I don't know if it is related to double vs uint64_t conversions or
         // an ImPlot issue
-        ImGui::Text("Visible period : %s", format_duration(group->plot_range_duration + 1).c_str());
-        ImGui::Text("Bar period : %s", format_duration((uint64_t)group->bar_width + 1).c_str());
+        ImGui::Text("Visible period : %s", frame_format_duration(frame.plot_range_duration + 1));
+        ImGui::Text("Bar period : %s", frame_format_duration((uint64_t)frame.bar_width + 1));
+        ImGui::NewLine();
+        ImGui::Text("Nb executions : %lld", frame.nb_executions);
+        ImGui::Text("Total execution time : %s", frame_format_duration(frame.total_execution_time));
+        ImGui::Text("Maximum duration : %s", frame_format_duration(frame.maximum_duration));
+        ImGui::Text("Average execution time : %s", frame_format_duration((uint64_t)frame.average_executions_time));
+        ImGui::NewLine();
+        ImGui::Text("CPU user time : %s", frame_format_duration(frame.total_user_time_ms / 1000));
+        ImGui::Text("CPU kernel time : %s", frame_format_duration(frame.total_kernel_time_ms / 1000));
+        if (frame.total_execution_time)
+            ImGui::Text("CPU / execution time : %.2f", (frame.total_user_time_ms + frame.total_kernel_time_ms) / 1000.0 / frame.total_execution_time);
+        ImGui::Text("Read : %s", frame_format_bytes(frame.total_read_bytes));
+        ImGui::Text("Written : %s", frame_format_bytes(frame.total_write_bytes));
+        ImGui::Text("Peak memory : %s", frame_format_bytes((uint64_t)frame.peak_memory_kb * 1024));
+        ImGui::NewLine();
+        ImGui::Text("Maximum running processes : %u", frame.maximum_concurrency);
+        ImGui::Text("Exclusive wall time (all records) :");
+        for (size_t i = 0; i < frame.exclusive_times.size() && i < group->executables.size(); i++)
+        {
+            ImGui::BulletText("%s : %s", frame_to_utf8(group->executables[i]),
+                frame_format_duration(frame.exclusive_times[i] / WINDOWS_TICK));
+        }
         ImGui::NewLine();
-        ImGui::Text("Nb executions : %lld", group->nb_executions);
-        ImGui::Text("Total execution time : %s", format_duration(group->total_execution_time).c_str());
-        ImGui::Text("Maximum duration : %s", format_duration(group->maximum_duration).c_str());
-        ImGui::Text("Average execution time : %s", format_duration((uint64_t)group->average_executions_time).c_str());
+
+        Tracking_Pool_Stats tracking_stats = get_tracking_pool_stats();
+        ImGui::Text("Running tracked processes : %zu", tracking_stats.nb_tracked_processes);
+        ImGui::Text("Tracking pool : %zu (peak %zu)", tracking_stats.capacity, tracking_stats.peak_nb_tracked_processes);
+        // From the end of a process to the first frame of its group, details are in the diagnostics window
+        if (get_nb_capture_latencies(Capture_Stage::end_to_end))
+            ImGui::Text("Capture lag (p99) : %.0f ms", get_capture_latency_percentile(Capture_Stage::end_to_end, 0.99) / 10'000.0);
     }
     ImGui::EndGroup();
 
@@ -150,301 +294,71 @@ void ui_frame()
 
     ImGui::End();
 
-    LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
-}
-
-void test_ui_insert_merge_entry()
-{
-    std::vector<RunningEntry>   initial_entries;
-
-    insert_merge_entry(initial_entries, { 5, 6 });
-    assert(initial_entries == std::vector<RunningEntry>({ {5, 6} }));
-
-    insert_merge_entry(initial_entries, { 7, 8 });
-    assert(initial_entries == std::vector<RunningEntry>({ {5, 6}, {7, 8} }));
-
-    insert_merge_entry(initial_entries, { 1, 3 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, {5, 6}, {7, 8} }));
-
-    insert_merge_entry(initial_entries, { 12, 13 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, {5, 6}, {7, 8}, {12, 13} }));
-
-    insert_merge_entry(initial_entries, { 13, 15 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, {5, 6}, {7, 8}, {12, 15} }));
-
-    insert_merge_entry(initial_entries, { 5, 9 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 3}, { 5, 9}, { 12, 15} }));
-
-    insert_merge_entry(initial_entries, { 2, 4 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 4}, {5, 9}, { 12, 15} }));
+    ui_diagnostics_window();
 
-    insert_merge_entry(initial_entries, { 10, 13 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 4}, {5, 9}, { 10, 15} }));
+    is_interacting = ImGui::IsAnyItemHovered() || ImGui::IsAnyItemActive() ||
+        ImGui::IsPopupOpen("", ImGuiPopupFlags_AnyPopupId | ImGuiPopupFlags_AnyPopupLevel);
 
-    // Merge on edges of ranges
-    initial_entries = { {1, 3}, { 5, 9}, { 12, 15} };
-
-    insert_merge_entry(initial_entries, { 2, 5 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 9}, { 12, 15} }));
-
-    insert_merge_entry(initial_entries, { 9, 13 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 15} }));
-
-    // Multiple merges
-    initial_entries = { {1, 3}, {5, 6}, {7, 8}, {12, 15} };
-    insert_merge_entry(initial_entries, { 1, 12 });
-    assert(initial_entries == std::vector<RunningEntry>({ {1, 15} }));
-
-    initial_entries = { {1, 3}, {5, 6}, {7, 8}, {12, 15} };
-    insert_merge_entry(initial_entries, { 0, 16 });
-    assert(initial_entries == std::vector<RunningEntry>({ {0, 16} }));
+    LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
 }
 
 // =============================================================================
 
-constexpr uint64_t WINDOWS_TICK = 10'000'000;
-constexpr uint64_t SEC_TO_UNIX_EPOCH = 11'644'473'600LL;
-
-inline uint64_t WindowsTickToUnixSeconds(uint64_t windowsTicks)
-{
-    return windowsTicks / WINDOWS_TICK - SEC_TO_UNIX_EPOCH;
-}
-
-inline uint64_t UnixSecondsToWindowsTick(uint64_t unixSeconds)
-{
-    return (unixSeconds + SEC_TO_UNIX_EPOCH) * WINDOWS_TICK;
-}
-
-/** @brief expect an already sorted vector of entries
-*/
-void insert_merge_entry(std::vector<RunningEntry>& merged_entries, const RunningEntry& entry)
+// ImPlot getter of points of a frame (user_data), dates are rebuilt from the base time of the frame
+template<std::vector<View_Point> View_Frame::* points>
+static ImPlotPoint get_frame_point(int index, void* user_data)
 {
-    bool start_overlap = false;
-    bool end_overlap = false;
-    size_t start_pos = merged_entries.size();
-    size_t end_pos = start_pos + 1;
-
-    // Search the position of start (@Speed reverse iteration)
-    for (size_t i = merged_entries.size() - 1; i != (size_t)-1; i--)
-    {
-        if (entry.start_time > merged_entries[i].end_time) // start_time of entry is just after the current one
-        {
-            start_pos = i + 1;
-            break;
-        }
-        else if (entry.start_time >= merged_entries[i].start_time) // start_time of entry is in the range of the current one
-        {
-            start_pos = i;
-            start_overlap = true;
-            break;
-        }
-        start_pos = i;
-    }
+    const View_Frame* frame = (const View_Frame*)user_data;
+    const View_Point& point = (frame->*points)[index];
 
-    // Search the position of end (@speed from start_pos)
-    for (end_pos = start_pos + 1; end_pos < merged_entries.size(); end_pos++)
-    {
-        if (entry.end_time < merged_entries[end_pos].start_time) // end_time of entry is just before the next one
-        {
-            break;
-        }
-        else if (entry.end_time <= merged_entries[end_pos].end_time) // end_time of entry is in the range of the next one
-        {
-            end_pos++;
-            end_overlap = true;
-            break;
-        }
-    }
-    // Fix end_overlap with latest range in merged_entries
-    if (end_pos - 1 < merged_entries.size())
-        end_overlap = entry.end_time >= merged_entries[end_pos - 1].start_time;
-
-    // Insertion/Merge
-    if (start_overlap == false && end_overlap == false && start_pos == end_pos - 1)
-    {
-        merged_entries.insert(std::next(merged_entries.begin(), start_pos), entry);
-    }
-    else
-    {
-        merged_entries[start_pos].start_time = std::min(merged_entries[start_pos].start_time, entry.start_time);
-        merged_entries[start_pos].end_time = std::max(merged_entries[end_pos - 1].end_time, entry.end_time);
-        if (start_pos - end_pos > 0)
-            merged_entries.erase(std::next(merged_entries.begin(), start_pos + 1), std::next(merged_entries.begin(), end_pos));
-    }
+    return ImPlotPoint(frame->base_time + point.x_offset, point.value);
 }
 
-void merge_durations(const std::vector<double>& durations, uint64_t period_duration, std::vector<double>& result)
+void draw_graph(Group* group, const View_Frame& frame)
 {
-    if (durations.empty())
-        return;
-
-    size_t insertion_index = -2;
-
-    result.reserve(durations.size());
-    for (size_t i = 0; i < durations.size(); i += 2)
-    {
-        const double& start_time = durations[i];
-        const double& duration = durations[i + 1];
-
-        double start_time_on_period = floor_at_unit(start_time, period_duration);
-
-        if (result.empty() || start_time_on_period != result[insertion_index])
-        {
-            result.push_back(start_time_on_period);
-            result.push_back(0.0);
-            insertion_index += 2;
-        }
-
-        result[insertion_index + 1] += duration;
-    }
-}
-
-uint64_t get_optimal_period_duration(double range_start_s, double range_end_s)
-{
-    uint64_t range_size = (uint64_t)(range_end_s - range_start_s);
-    constexpr size_t min_nb_periods = 10; // @TODO may I need to adapt this to the actual plot width (in pixels)?
-
-    if (range_size > 10 * year_duration)
-        return (uint64_t)year_duration;
-    if (range_size > 4 * year_duration)
-        return 6 * (uint64_t)month_duration;
-    if (range_size > 2 * year_duration)
-        return 3 * (uint64_t)month_duration;
-    else if (range_size > 10 * (uint64_t)month_duration)
-        return (uint64_t)month_duration;
-    else if (range_size > 6 * (uint64_t)month_duration)
-        return 2 * week_duration;
-    else if (range_size > 2 * (uint64_t)month_duration)
-        return week_duration;
-    else if (range_size > (uint64_t)month_duration)
-        return 3 * day_duration;
-    else if (range_size > 2 * week_duration)
-        return day_duration;
-    else if (range_size > 6 * day_duration)
-        return 12 * hour_duration;
-    else if (range_size > 2 * day_duration)
-        return 6 * hour_duration;
-    else if (range_size > day_duration)
-        return 2 * hour_duration;
-    else if (range_size > 12 * hour_duration)
-        return 30 * minute_duration;
-    else if (range_size > 4 * hour_duration)
-        return 15 * minute_duration;
-    else if (range_size > hour_duration)
-        return 10 * minute_duration;
-    else if (range_size > 5 * minute_duration)
-        return minute_duration;
-    else if (range_size > minute_duration)
-        return 15 * second_duration;
-
-    return second_duration;
-}
-
-void generate_time_data(Group* group)
-{
-    EnterCriticalSection(&group->executions_critical_section);
-    if (group->executions.size())
-    {
-        // Merge entries
-        group->merged_executions.reserve(group->merged_executions.size() + group->executions.size());
-        for (size_t i = 0; i < group->executions.size(); i++)
-        {
-            insert_merge_entry(group->merged_executions, group->executions[i]);
-        }
-        group->executions.clear();
-    }
-    LeaveCriticalSection(&group->executions_critical_section);
-}
-
-void generate_view_data(Group* group, double start, double end, double merging_range)
-{
-    // Clear data
-    group->plot_durations.clear();
-    group->plot_durations.reserve(group->merged_executions.size() * 2);
-    group->plot_merged_durations.clear();
-    group->bar_width = 1.0;
-
-    group->plot_range_duration = (uint64_t)end - (uint64_t)start;
-    group->nb_executions = 0;
-    group->total_execution_time = 0;
-    group->maximum_duration = 0;
-    group->average_executions_time = 0;
-
-    // @TODO compute the optimal period of bars depending on the timeline scale
-    uint64_t period_duration = get_optimal_period_duration(start, end);
-
-    // @TODO get group->merged_execution range out-side the main loop to ease the cumulation of durations
-    // @SpeedUp, we should be able to do a fast search of the sub-range because merged_executions are sorted
-
-    for (size_t i = 0; i < group->merged_executions.size(); i++)
-    {
-        double starting_date = (double)WindowsTickToUnixSeconds(group->merged_executions[i].start_time);
-
-        // As bars are offseted by half there width we should have to enlarge the "visible" range
-        if (starting_date < floor_at_unit(start + 0.5 * period_duration, period_duration) || starting_date > floor_at_unit(end + 1.5 * period_duration, period_duration))
-            continue;
-        
-        uint64_t duration = (group->merged_executions[i].end_time - group->merged_executions[i].start_time) / WINDOWS_TICK;
-
-        group->plot_durations.push_back(starting_date);
-        group->plot_durations.push_back((double)duration);
-
-        group->nb_executions++;
-        group->total_execution_time += duration;
-        group->maximum_duration = std::max(duration, group->maximum_duration);
-        group->average_executions_time = group->total_execution_time / (double)group->nb_executions;
-
-        // Stick bars on minutes, hours,... and compute a bar_width
-    }
-
-    // Merge durations for bars
-    merge_durations(group->plot_durations, period_duration, group->plot_merged_durations);
-    group->bar_width = (double)period_duration;
-
-    // Scale durations depending on the ideal time unit
-    {
-        double max_merged_duration = 0.0;
-        for (size_t i = 1; i < group->plot_merged_durations.size(); i += 2)
-            max_merged_duration = std::max(max_merged_duration, group->plot_merged_durations[i]);
-        group->duration_unit = get_time_unit((uint64_t)max_merged_duration);
-
-        for (size_t i = 1; i < group->plot_merged_durations.size(); i += 2)
-            group->plot_merged_durations[i] /= get_time_unit_divisor(group->duration_unit);
-    }
-}
-
-void draw_graph(Group* group)
-{
-    generate_time_data(group);
+    TRACE_ZONE("draw_graph");
 
     if (ImPlot::BeginPlot("##Time", ImVec2(-1, -1))) {
         double now_date = (double)time(0);
 
         ImPlot::SetupAxis(ImAxis_X1, "date", ImPlotAxisFlags_Time);
         ImPlot::SetupAxis(ImAxis_Y1, "duration", /*ImPlotAxisFlags_Time |*/ ImPlotAxisFlags_LockMin | ImPlotAxisFlags_AutoFit);
-        ImPlot::SetupAxisLimits(ImAxis_X1, now_date - (24.0 * 60.0 * 60.0), now_date + (24.0 * 60.0 * 60.0)); // 2 days around current date
+        if (graph_range_end > graph_range_start)
+            ImPlot::SetupAxisLimits(ImAxis_X1, graph_range_start, graph_range_end);
+        else
+            ImPlot::SetupAxisLimits(ImAxis_X1, now_date - (24.0 * 60.0 * 60.0), now_date + (24.0 * 60.0 * 60.0)); // 2 days around current date
         ImPlot::SetupAxisLimits(ImAxis_Y1, 0.0, 10 * 60.0); // from 0.0 to 10min
 
-        ImPlot::SetupAxisFormat(ImAxis_Y1, &duration_formmatter, group);
+        ImPlot::SetupAxisFormat(ImAxis_Y1, &duration_formmatter, (void*)&frame);
+        ImPlot::SetupAxis(ImAxis_Y2, "running processes", ImPlotAxisFlags_AuxDefault | ImPlotAxisFlags_LockMin | ImPlotAxisFlags_AutoFit);
 
         ImPlotRect plot_rect = ImPlot::GetPlotLimits(ImAxis_X1, ImAxis_Y2);
-        generate_view_data(group, plot_rect.Min().x, plot_rect.Max().x, 1.0);
-
-        ImPlot::PlotBars(group->name.c_str(),
-            &group->plot_merged_durations.data()[0], &group->plot_merged_durations.data()[1],
-            (int)group->plot_merged_durations.size() / 2, group->bar_width * 0.8, 0,
-            2 * sizeof(double));
+        graph_range_start = plot_rect.Min().x;
+        graph_range_end = plot_rect.Max().x;
+        request_view(group->id, graph_range_start, graph_range_end);
+
+        // Points are read in place from the frame, there is no conversion buffer
+        ImPlot::PlotBarsG(group->name.c_str(), &get_frame_point<&View_Frame::bars>, (void*)&frame,
+            (int)frame.bars.size(), frame.bar_width * 0.8);
+        // Above bars when processes run in parallel, under them when they wait (I/O, other processes,...)
+        ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 3.0f);
+        ImPlot::PlotLineG("CPU time", &get_frame_point<&View_Frame::cpu_points>, (void*)&frame,
+            (int)frame.cpu_points.size());
+
+        ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+        ImPlot::PlotStairsG("Running processes", &get_frame_point<&View_Frame::concurrency_steps>, (void*)&frame,
+            (int)frame.concurrency_steps.size());
         ImPlot::EndPlot();
     }
 }
 
 void duration_formmatter(double value, char* buff, int size, void* user_data)
 {
-    Group* group = (Group*)user_data;
+    const View_Frame* frame = (const View_Frame*)user_data;
 
     std::format_to_n_result<char*> result;
 
-    result = std::format_to_n(buff, size, "{:.1f} {}", value, get_time_unit_short_label(group->duration_unit));
+    result = std::format_to_n(buff, size - 1, "{:.1f} {}", value, get_time_unit_short_label(frame->duration_unit));
 
     *result.out = '\0';
 }
@@ -454,10 +368,12 @@ void ui_groups_dialog()
     static std::string current_group_name;
     static Rename_Errors rename_result = Rename_Errors::no_error;
     static Update_Processes_Errors update_processes_result = Update_Processes_Errors::no_error;
-    static ImVec2 popup_size = ImVec2(500, 170);
+    static Update_Processes_Errors update_predicates_result = Update_Processes_Errors::no_error;
+    static ImVec2 popup_size = ImVec2(500, 330);
 
     char new_group_name_buffer[group_name_maximum_length];
     char process_buffer[processes_string_maximum_length];
+    char predicates_buffer[processes_string_maximum_length];
 
     new_group_name_buffer[0] = '\0';
     if (g_dear_time.groups_dialog)
@@ -473,7 +389,7 @@ void ui_groups_dialog()
             ImGui::SetNextItemWidth(maximum_group_name_ui_width());
             if (ImGui::BeginCombo("###Group", current_group_name.c_str()))
             {
-                for (auto it : g_dear_time.groups)
+                for (const auto& it : g_dear_time.groups)
                 {
                     bool is_selected = (current_group_name == it.second->name);
 
@@ -539,11 +455,12 @@ void ui_groups_dialog()
         }
 
         get_processes_string(current_group_name, process_buffer, sizeof(process_buffer));
-        ImGui::Text("Executable names (separated by semicolons):");
+        ImGui::Text("Executable names, * and ? wildcards allowed (separated by semicolons):");
         ImGui::SetNextItemWidth(-1);
         if (ImGui::InputText("###Executables", process_buffer, sizeof(process_buffer), update_processes_flags))
         {
             update_processes_result = udpate_processes(current_group_name, process_buffer, processes_string_maximum_length);
+            attach_running_processes(get_tracking_group(current_group_name));
         }
 
         if (update_processes_result == Update_Processes_Errors::no_error)
@@ -556,6 +473,142 @@ void ui_groups_dialog()
             ImGui::PopStyleColor();
         }
 
+        get_command_line_predicates_string(current_group_name, predicates_buffer, sizeof(predicates_buffer));
+        ImGui::Text("Only when the command line contains one of (separated by semicolons):");
+        ImGui::SetNextItemWidth(-1);
+        if (ImGui::InputTextWithHint("###Arguments", "any command line", predicates_buffer, sizeof(predicates_buffer), update_processes_flags))
+        {
+            update_predicates_result = update_command_line_predicates(current_group_name, predicates_buffer, processes_string_maximum_length);
+            attach_running_processes(get_tracking_group(current_group_name));
+        }
+
+        if (update_predicates_result == Update_Processes_Errors::too_many_processes)
+        {
+            ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
+            ImGui::Text("There is too many filters to be able to display the list!?");
+            ImGui::PopStyleColor();
+        }
+
+        Group* current_group = get_tracking_group(current_group_name);
+        if (current_group)
+        {
+            bool    detect_freezes = current_group->freeze_cpu_threshold_percent != 0;
+            int     cpu_threshold_percent = detect_freezes ? (int)current_group->freeze_cpu_threshold_percent : 90;
+            int     minimum_duration_ms = (int)current_group->freeze_minimum_duration_ms;
+            bool    changed = false;
+            bool    track_process_tree = current_group->track_process_tree;
+
+            if (ImGui::Checkbox("Also track all processes started by these ones", &track_process_tree))
+                update_track_process_tree(current_group_name, track_process_tree);
+
+            changed |= ImGui::Checkbox("Record freezes instead of executions", &detect_freezes);
+            if (detect_freezes)
+            {
+                ImGui::SetNextItemWidth(maximum_group_name_ui_width());
+                changed |= ImGui::SliderInt("CPU usage of a core", &cpu_threshold_percent, 10, 100, "%d %%");
+                ImGui::SetNextItemWidth(maximum_group_name_ui_width());
+                changed |= ImGui::SliderInt("Minimum duration", &minimum_duration_ms, 250, 30'000, "%d ms");
+            }
+            if (changed)
+                update_freeze_detection(current_group_name, detect_freezes ? cpu_threshold_percent : 0, minimum_duration_ms);
+        }
+
         ImGui::EndPopup();
     }
 }
+
+// Histograms are built from the rings of diagnostics.h only while the window is shown
+void ui_diagnostics_window()
+{
+    if (!g_dear_time.diagnostics_window)
+        return;
+
+    ImGui::SetNextWindowSize(ImVec2(420, 640), ImGuiCond_FirstUseEver);
+    bool is_expanded = ImGui::Begin("Diagnostics", &g_dear_time.diagnostics_window);
+    add_interactive_region(ImGui::GetWindowPos(), ImVec2(ImGui::GetWindowPos().x + ImGui::GetWindowSize().x, ImGui::GetWindowPos().y + ImGui::GetWindowSize().y));
+    if (!is_expanded)
+    {
+        ImGui::End();
+        return;
+    }
+
+    // The rate is measured over at least a second, frames are only drawn when something changes
+    static uint64_t rate_start_ns = 0;
+    static uint32_t rate_start_nb_redraw_requests = 0;
+    static double   redraw_requests_per_s = 0.0;
+    uint64_t        now_ns = get_diagnostic_time_ns();
+
+    if (now_ns - rate_start_ns >= 1'000'000'000)
+    {
+        uint32_t nb_redraw_requests = (uint32_t)g_dear_time.nb_redraw_requests;
+
+        if (rate_start_ns)
+            redraw_requests_per_s = (nb_redraw_requests - rate_start_nb_redraw_requests) / ((now_ns - rate_start_ns) / 1e9);
+        rate_start_ns = now_ns;
+        rate_start_nb_redraw_requests = nb_redraw_requests;
+    }
+
+    ImGui::Text("Redraw requests : %.1f / s", redraw_requests_per_s);
+    ImGui::Text("Frames drawn : %llu", (unsigned long long)g_dear_time.nb_drawn_frames);
+    // Each of them requested min_nb_redraws frames before they were classified
+    ImGui::Text("Ignored window messages : %llu (up to %llu frames saved)", (unsigned long long)g_dear_time.nb_ignored_messages,
+        (unsigned long long)g_dear_time.nb_ignored_messages * min_nb_redraws);
+    if (*g_dear_time.nb_requested_redraws == 0xffffffff)
+        ImGui::Text("Pending redraws : permanent (text input)");
+    else
+        ImGui::Text("Pending redraws : %u", (uint32_t)*g_dear_time.nb_requested_redraws);
+    ImGui::NewLine();
+
+    double* samples_ms = (double*)frame_arena.allocate(diagnostic_history_size * sizeof(double), alignof(double));
+
+    for (uint32_t series_index = 0; series_index < (uint32_t)Diagnostic_Series::count; series_index++)
+    {
+        Diagnostic_Series   series = (Diagnostic_Series)series_index;
+        const char*         label = get_diagnostic_series_label(series);
+        size_t              nb_samples = get_diagnostic_samples(series, samples_ms, diagnostic_history_size);
+
+        if (nb_samples == 0)
+        {
+            ImGui::Text("%s : no sample", label);
+            continue;
+        }
+
+        std::sort(samples_ms, samples_ms + nb_samples);
+        ImGui::Text("%s : p50 %.3f ms, p99 %.3f ms, max %.3f ms (%zu)", label,
+            samples_ms[nb_samples / 2], samples_ms[std::min(nb_samples * 99 / 100, nb_samples - 1)], samples_ms[nb_samples - 1], nb_samples);
+
+        ImGui::PushID(series_index);
+        if (ImPlot::BeginPlot("##Histogram", ImVec2(-1, 80), ImPlotFlags_NoLegend | ImPlotFlags_NoMenus | ImPlotFlags_NoMouseText))
+        {
+            ImPlot::SetupAxes(NULL, NULL, ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            ImPlot::PlotHistogram(label, samples_ms, (int)nb_samples);
+            ImPlot::EndPlot();
+        }
+        ImGui::PopID();
+    }
+    ImGui::NewLine();
+
+    // Whole session, executions of groups that aren't viewed never reach the display
+    ImGui::Text("Capture lag :");
+    for (uint32_t stage_index = 0; stage_index < (uint32_t)Capture_Stage::count; stage_index++)
+    {
+        Capture_Stage stage = (Capture_Stage)stage_index;
+
+        ImGui::BulletText("%s : p50 %.1f ms, p99 %.1f ms (%llu)", get_capture_stage_label(stage),
+            get_capture_latency_percentile(stage, 0.5) / 10'000.0, get_capture_latency_percentile(stage, 0.99) / 10'000.0,
+            (unsigned long long)get_nb_capture_latencies(stage));
+    }
+    if (ImGui::Button("Export"))
+        save_capture_lag_histograms(g_dear_time.app_data_folder_path + L"\\capture_lag.csv");
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        reset_capture_lag_histograms();
+    ImGui::NewLine();
+
+    // Updated by the view thread when executions are merged
+    ImGui::Text("Memory of groups :");
+    for (const auto& it : g_dear_time.groups)
+        ImGui::BulletText("%s : %s", it.second->name.c_str(), frame_format_bytes(it.second->memory_bytes.load(std::memory_order_relaxed)));
+
+    ImGui::End();
+}
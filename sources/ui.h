@@ -1,6 +1,9 @@
 #pragma once
 
 void initialize_ui();
+void terminate_ui();
 void ui_frame();
 
-void test_ui_insert_merge_entry();
+// Whether a mouse move to this position (client coordinates) can change the output, from the hovered
+// and active items, open popups and interactive regions of the last frame (main thread)
+bool ui_is_mouse_move_relevant(float x, float y);
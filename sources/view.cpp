@@ -0,0 +1,533 @@
+#include "view.h"
+
+#include "application.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+#include <cassert>
+
+struct View_Request
+{
+	uint32_t	group_id = 0xffffffff;
+	double		start = 0.0;
+	double		end = 0.0;
+
+	bool operator==(const View_Request& other) const = default;
+};
+
+// Frames are triple buffered, the view thread fills work_frame while the render thread draws
+// displayed_frame, ready_frame is the latest completed one. Only pointers are exchanged.
+static CRITICAL_SECTION	view_critical_section; // Protect requested_view and the exchange of frames
+static View_Request		requested_view;
+static volatile LONG	requested_view_generation = 0; // Incremented with each new requested view
+static View_Frame		frames[3];
+static View_Frame*		work_frame = &frames[0];
+static View_Frame*		ready_frame = &frames[1];
+static View_Frame*		displayed_frame = &frames[2];
+static bool				is_ready_frame_new = false;
+
+static HANDLE			view_thread = NULL;
+static HANDLE			stop_event = NULL;
+static HANDLE			update_event = NULL;
+static volatile LONG	is_update_requested = 0;
+
+// Background mode, executions are still merged for the backups but no frame is prepared
+static volatile LONG	is_view_suspended = 0;
+static HANDLE			suspended_event = NULL; // Signaled once the buffers are released
+
+// A computation for a view that isn't requested anymore is abandoned, the render thread keeps drawing
+// the last completed frame meanwhile (bars are placed at absolute dates so it stays right while zooming
+// or panning, only the newly exposed parts are missing)
+inline bool is_view_cancelled(LONG generation)
+{
+	return requested_view_generation != generation;
+}
+
+// Buckets of the viewed group over contiguous periods, wider than the visible range. While panning only
+// the newly exposed periods are computed, and once a frame is published periods ahead of the motion are
+// prefetched. Merging executions invalidates buckets from the earliest change.
+// @Warning Only used by the view thread
+struct View_Cache
+{
+	uint32_t					group_id = 0xffffffff;
+	uint64_t					period_duration = 0;
+	uint64_t					first_period = 0; // Of buckets[0], in periods since the Unix epoch
+	std::vector<Period_Bucket>	buckets;
+	std::vector<Period_Bucket>	strip; // Buckets being computed
+
+	uint64_t get_end_period() const { return first_period + buckets.size(); }
+};
+
+constexpr uint64_t maximum_nb_cached_ranges = 2; // Cached periods on each side of the visible ones, in visible ranges
+
+static View_Cache view_cache;
+
+// Buffers of the frames and of the cache are given back to the heap, they are rebuilt by the first frame
+// prepared after resume_view
+// @Warning The render thread shouldn't use its frame while the view is suspended
+static void release_view_buffers()
+{
+	EnterCriticalSection(&view_critical_section);
+	for (View_Frame& frame : frames)
+		frame = View_Frame();
+	is_ready_frame_new = false;
+	LeaveCriticalSection(&view_critical_section);
+
+	view_cache = View_Cache();
+}
+
+// Periods of bars to aggregate for a visible range [first_period, end_period[
+static void get_visible_periods(double start, double end, uint64_t period_duration, uint64_t& first_period, uint64_t& end_period)
+{
+	// As bars are offseted by half there width we should have to enlarge the "visible" range
+	first_period = (uint64_t)std::max(start + 0.5 * period_duration, 0.0) / period_duration;
+	end_period = std::max((uint64_t)std::max(end + 1.5 * period_duration, 0.0) / period_duration, first_period);
+}
+
+// Aggregate periods [first_period, end_period[, return false if cancelled
+static bool compute_buckets(const Group* group, uint64_t period_duration, uint64_t first_period, uint64_t end_period, LONG generation, std::vector<Period_Bucket>& buckets)
+{
+	return aggregate_periods(group->merged_executions, group->resources, period_duration, first_period, end_period, buckets,
+		[generation]() { return is_view_cancelled(generation); });
+}
+
+// Make the cache cover at least [first_period, end_period[, only missing periods are computed
+// Return false if cancelled
+static bool update_view_cache(const Group* group, uint64_t period_duration, uint64_t first_period, uint64_t end_period, LONG generation)
+{
+	View_Cache& cache = view_cache;
+
+	if (cache.group_id != group->id || cache.period_duration != period_duration || cache.buckets.empty()
+		|| end_period < cache.first_period || first_period > cache.get_end_period())
+	{
+		if (!compute_buckets(group, period_duration, first_period, end_period, generation, cache.strip))
+			return false;
+
+		cache.group_id = group->id;
+		cache.period_duration = period_duration;
+		cache.first_period = first_period;
+		cache.buckets.swap(cache.strip);
+		return true;
+	}
+
+	if (first_period < cache.first_period)
+	{
+		if (!compute_buckets(group, period_duration, first_period, cache.first_period, generation, cache.strip))
+			return false;
+
+		cache.buckets.insert(cache.buckets.begin(), cache.strip.begin(), cache.strip.end());
+		cache.first_period = first_period;
+	}
+	if (end_period > cache.get_end_period())
+	{
+		if (!compute_buckets(group, period_duration, cache.get_end_period(), end_period, generation, cache.strip))
+			return false;
+
+		cache.buckets.insert(cache.buckets.end(), cache.strip.begin(), cache.strip.end());
+	}
+	return true;
+}
+
+// Merged executions of the group changed from earliest_change (Windows ticks)
+static void invalidate_view_cache(uint32_t group_id, uint64_t earliest_change)
+{
+	View_Cache& cache = view_cache;
+
+	if (cache.group_id != group_id || cache.buckets.empty() || earliest_change == UINT64_MAX)
+		return;
+
+	uint64_t period = WindowsTickToUnixSeconds(earliest_change) / cache.period_duration;
+
+	if (period <= cache.first_period)
+		cache.buckets.clear();
+	else if (period < cache.get_end_period())
+		cache.buckets.resize(period - cache.first_period);
+}
+
+// Keep at most maximum_nb_cached_ranges visible ranges of periods on each side of the visible ones
+static void trim_view_cache(uint64_t first_visible_period, uint64_t end_visible_period)
+{
+	View_Cache&	cache = view_cache;
+	uint64_t	margin = maximum_nb_cached_ranges * std::max(end_visible_period - first_visible_period, (uint64_t)1);
+
+	if (end_visible_period + margin < cache.get_end_period())
+		cache.buckets.resize(end_visible_period + margin - cache.first_period);
+	if (cache.first_period + margin < first_visible_period && first_visible_period - margin < cache.get_end_period())
+	{
+		uint64_t nb_trimmed = first_visible_period - margin - cache.first_period;
+
+		cache.buckets.erase(cache.buckets.begin(), cache.buckets.begin() + nb_trimmed);
+		cache.first_period += nb_trimmed;
+	}
+}
+
+// Return false if cancelled by a newer request before the end, frame is then incomplete
+static bool generate_view_data(const Group* group, double start, double end, LONG generation, View_Frame& frame)
+{
+	TRACE_ZONE("generate_view_data");
+
+	// @TODO compute the optimal period of bars depending on the timeline scale
+	uint64_t period_duration = get_optimal_period_duration(start, end);
+	uint64_t first_period;
+	uint64_t end_period;
+
+	get_visible_periods(start, end, period_duration, first_period, end_period);
+	if (!update_view_cache(group, period_duration, first_period, end_period, generation))
+		return false;
+
+	// Clear data, vectors keep their capacity from a frame to the next one
+	frame.base_time = (double)(first_period * period_duration);
+	frame.bars.clear();
+	frame.bar_width = (double)period_duration;
+
+	frame.plot_range_duration = (uint64_t)end - (uint64_t)start;
+	frame.nb_executions = 0;
+	frame.total_execution_time = 0;
+	frame.maximum_duration = 0;
+	frame.average_executions_time = 0;
+
+	frame.cpu_points.clear();
+	frame.total_user_time_ms = 0;
+	frame.total_kernel_time_ms = 0;
+	frame.total_read_bytes = 0;
+	frame.total_write_bytes = 0;
+	frame.peak_memory_kb = 0;
+
+	// Totals of the visible bar periods, the highest bar gives the time unit of the graph
+	uint64_t maximum_bar_duration = 0;
+
+	for (uint64_t period = first_period; period < end_period; period++)
+	{
+		const Period_Bucket& bucket = view_cache.buckets[period - view_cache.first_period];
+
+		frame.nb_executions += bucket.nb_executions;
+		frame.total_execution_time += bucket.total_execution_time;
+		frame.maximum_duration = std::max(bucket.maximum_duration, frame.maximum_duration);
+		maximum_bar_duration = std::max(bucket.total_execution_time, maximum_bar_duration);
+
+		frame.total_user_time_ms += bucket.user_time_ms;
+		frame.total_kernel_time_ms += bucket.kernel_time_ms;
+		frame.total_read_bytes += bucket.read_bytes;
+		frame.total_write_bytes += bucket.write_bytes;
+		frame.peak_memory_kb = std::max(frame.peak_memory_kb, bucket.peak_memory_kb);
+	}
+	if (frame.nb_executions)
+		frame.average_executions_time = frame.total_execution_time / (double)frame.nb_executions;
+	frame.duration_unit = get_time_unit(maximum_bar_duration);
+
+	// Points read by the graph, a bar is at the start of its period
+	double divisor = (double)get_time_unit_divisor(frame.duration_unit);
+
+	for (uint64_t period = first_period; period < end_period; period++)
+	{
+		const Period_Bucket&	bucket = view_cache.buckets[period - view_cache.first_period];
+		float				x_offset = (float)((period - first_period) * period_duration);
+
+		if (bucket.nb_executions)
+			frame.bars.push_back({ x_offset, (float)(bucket.total_execution_time / divisor) });
+		if (bucket.nb_resources)
+			frame.cpu_points.push_back({ x_offset, (float)((bucket.user_time_ms + bucket.kernel_time_ms) / 1000.0 / divisor) });
+	}
+
+	// Concurrency steps in the visible range, plus the step before to know the starting level. They are read
+	// in place, the timeline includes the executions still running at the end of the sweep.
+	const Concurrency_Timeline&		concurrency = group->concurrency;
+	const std::vector<uint64_t>&	step_times = concurrency.step_times;
+
+	frame.exclusive_times = concurrency.exclusive_times; // Per executable
+	frame.maximum_concurrency = concurrency.maximum_concurrency;
+
+	frame.concurrency_steps.clear();
+	auto it = std::lower_bound(step_times.begin(), step_times.end(), UnixSecondsToWindowsTick((uint64_t)std::max(start, 0.0)));
+	if (it != step_times.begin())
+		--it;
+	for (; it != step_times.end(); ++it)
+	{
+		double date = (double)WindowsTickToUnixSeconds(*it);
+
+		frame.concurrency_steps.push_back({ (float)(date - frame.base_time), (float)concurrency.step_counts[std::distance(step_times.begin(), it)] });
+		if (date > end)
+			break;
+	}
+	return true;
+}
+
+static DWORD WINAPI view_thread_main(LPVOID)
+{
+	HANDLE				events[] = { stop_event, update_event };
+	std::vector<Group*>	groups;
+	std::vector<Group*>	retired_groups;
+	View_Request		frame_request; // Of the last prepared frame
+
+	// Executions of the viewed group merged since the last prepared frame, for the capture lag
+	std::vector<Execution_Capture>	unshown_captures;
+	uint32_t						unshown_captures_group_id = View_Frame().group_id;
+
+	TRACE_THREAD_NAME("View");
+	while (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+	{
+		InterlockedExchange(&is_update_requested, 0);
+
+		View_Request	request;
+		LONG			generation;
+
+		EnterCriticalSection(&view_critical_section);
+		request = requested_view;
+		generation = requested_view_generation;
+		LeaveCriticalSection(&view_critical_section);
+
+		Group* view_group;
+
+		enter_editing_groups_critical_section();
+		{
+			groups.clear();
+			for (const auto& group_pair : g_dear_time.groups)
+				groups.push_back(group_pair.second);
+			view_group = get_tracking_group_by_id(request.group_id);
+			retired_groups.swap(g_dear_time.retired_groups);
+		}
+		LeaveCriticalSection(&g_dear_time.editing_groups_critical_section);
+
+		// Groups are freed here as this thread is the only one that use them after their deletion,
+		// they were retired before this iteration so they are not in groups anymore
+		for (Group* group : retired_groups)
+			delete group;
+		retired_groups.clear();
+
+		if (request.group_id != unshown_captures_group_id || !view_group)
+		{
+			unshown_captures.clear();
+			unshown_captures_group_id = request.group_id;
+		}
+
+		// All groups are merged, not only the viewed one, to keep backups up to date
+		bool is_suspended = is_view_suspended != 0;
+		bool has_view_changed = !(request == frame_request);
+		auto merge_start = std::chrono::steady_clock::now();
+
+		{
+			TRACE_ZONE("merge_pending_executions");
+
+			for (Group* group : groups)
+			{
+				uint64_t earliest_change = merge_pending_executions(group, group == view_group && !is_suspended ? &unshown_captures : nullptr);
+
+				invalidate_view_cache(group->id, earliest_change);
+				has_view_changed |= earliest_change != UINT64_MAX && group == view_group;
+			}
+		}
+
+		auto generation_start = std::chrono::steady_clock::now();
+
+		record_diagnostic_sample(Diagnostic_Series::ingest, std::chrono::duration_cast<std::chrono::nanoseconds>(generation_start - merge_start).count());
+		if (is_suspended)
+		{
+			// Executions merged in the background are not counted by the display stage of the capture lag
+			release_view_buffers();
+			std::vector<Execution_Capture>().swap(unshown_captures);
+			frame_request = View_Request(); // The frame of the request is prepared again once resumed
+			SetEvent(suspended_event);
+			continue;
+		}
+		if (!has_view_changed)
+			continue;
+
+		if (!view_group)
+			*work_frame = View_Frame();
+		else if (!generate_view_data(view_group, request.start, request.end, generation, *work_frame))
+			continue; // The new request already signaled update_event
+		work_frame->group_id = view_group ? request.group_id : View_Frame().group_id;
+		work_frame->range_start = request.start;
+		work_frame->range_end = request.end;
+		work_frame->merge_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(generation_start - merge_start).count();
+		work_frame->generation_duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - generation_start).count();
+		record_diagnostic_sample(Diagnostic_Series::view_generation, work_frame->generation_duration_ns);
+
+		// Direction of the panning, the next periods are likely to be there
+		double motion = request.group_id == frame_request.group_id ? request.start - frame_request.start : 0.0;
+		frame_request = request;
+
+		work_frame->captures.swap(unshown_captures);
+		unshown_captures.clear();
+
+		EnterCriticalSection(&view_critical_section);
+		if (is_ready_frame_new) // Replaced before being drawn, this frame is the first one to show its executions
+			work_frame->captures.insert(work_frame->captures.end(), ready_frame->captures.begin(), ready_frame->captures.end());
+		std::swap(work_frame, ready_frame);
+		is_ready_frame_new = true;
+		LeaveCriticalSection(&view_critical_section);
+
+		request_redraw();
+
+		// Prefetch one visible range ahead of the motion, if a new range is requested in the meantime it is
+		// cancelled like a frame
+		if (view_group && motion != 0.0 && view_cache.group_id == view_group->id)
+		{
+			uint64_t first_period;
+			uint64_t end_period;
+
+			get_visible_periods(request.start, request.end, view_cache.period_duration, first_period, end_period);
+
+			uint64_t nb_periods = end_period - first_period;
+
+			if (motion > 0.0)
+				update_view_cache(view_group, view_cache.period_duration, first_period, end_period + nb_periods, generation);
+			else
+				update_view_cache(view_group, view_cache.period_duration, first_period - std::min(first_period, nb_periods), end_period, generation);
+			trim_view_cache(first_period, end_period);
+		}
+	}
+	return 0;
+}
+
+bool initialize_view_thread()
+{
+	InitializeCriticalSection(&view_critical_section);
+
+	stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	update_event = CreateEvent(NULL, FALSE, TRUE, NULL); // Signaled to merge executions loaded from the record file
+	suspended_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (stop_event == NULL || update_event == NULL || suspended_event == NULL)
+		return false;
+
+	view_thread = CreateThread(NULL, 0, &view_thread_main, NULL, 0, NULL);
+	return view_thread != NULL;
+}
+
+void terminate_view_thread()
+{
+	SetEvent(stop_event);
+	WaitForSingleObject(view_thread, INFINITE);
+	CloseHandle(view_thread);
+	CloseHandle(stop_event);
+	CloseHandle(update_event);
+	CloseHandle(suspended_event);
+	DeleteCriticalSection(&view_critical_section);
+}
+
+void request_view(uint32_t group_id, double start, double end)
+{
+	View_Request request = { group_id, start, end };
+
+	EnterCriticalSection(&view_critical_section);
+	bool has_changed = !(request == requested_view);
+	if (has_changed)
+	{
+		requested_view = request;
+		InterlockedIncrement(&requested_view_generation); // Cancel the computation of the previous one
+	}
+	LeaveCriticalSection(&view_critical_section);
+
+	if (has_changed)
+		request_view_update();
+}
+
+void request_view_update()
+{
+	// Coalesce requests, the thread resets the flag before reading what to update
+	if (InterlockedExchange(&is_update_requested, 1) == 0)
+		SetEvent(update_event);
+}
+
+void suspend_view()
+{
+	ResetEvent(suspended_event);
+	InterlockedExchange(&is_view_suspended, 1);
+	InterlockedIncrement(&requested_view_generation); // Cancel the frame being prepared
+	request_view_update();
+	WaitForSingleObject(suspended_event, INFINITE);
+}
+
+void resume_view()
+{
+	InterlockedExchange(&is_view_suspended, 0);
+	request_view_update();
+}
+
+const View_Frame& get_view_frame()
+{
+	bool is_new = false;
+
+	EnterCriticalSection(&view_critical_section);
+	if (is_ready_frame_new)
+	{
+		std::swap(displayed_frame, ready_frame);
+		is_ready_frame_new = false;
+		is_new = true;
+	}
+	LeaveCriticalSection(&view_critical_section);
+
+	if (is_new && !displayed_frame->captures.empty())
+	{
+		uint64_t display_time = get_current_windows_ticks();
+
+		for (const Execution_Capture& capture : displayed_frame->captures)
+		{
+			record_capture_latency(Capture_Stage::display, capture.merge_time, display_time);
+			record_capture_latency(Capture_Stage::end_to_end, capture.end_time, display_time);
+		}
+	}
+	return *displayed_frame;
+}
+
+void test_view_cache()
+{
+	Group		group;
+	uint64_t	base = 1'700'000'000;
+
+	group.id = 1;
+	for (uint64_t i = 0; i < 1000; i++)
+	{
+		uint64_t			start_time = UnixSecondsToWindowsTick(base + i * 97);
+		Execution_Resources	resources = {};
+
+		group.merged_executions.push_back({ start_time, start_time + 40 * WINDOWS_TICK });
+		resources.start_time = start_time;
+		resources.end_time = start_time + 40 * WINDOWS_TICK;
+		resources.user_time_ms = (uint32_t)(i % 7) * 100;
+		resources.write_bytes = i;
+		group.resources.push_back(resources);
+	}
+
+	// Panning back and forth reuses and extends the cache, frames should be the ones of a fresh computation
+	View_Frame	panned;
+	View_Frame	fresh;
+	double		width = 3600.0 * 6;
+
+	view_cache = View_Cache();
+	for (double shift : { 0.0, 1000.0, 2500.0, -4000.0, 30000.0, 200000.0, 5.0 })
+	{
+		double start = (double)base + shift;
+
+		assert(generate_view_data(&group, start, start + width, requested_view_generation, panned));
+
+		View_Cache cache = view_cache;
+
+		view_cache = View_Cache();
+		assert(generate_view_data(&group, start, start + width, requested_view_generation, fresh));
+		view_cache = cache;
+
+		assert(panned.base_time == fresh.base_time && panned.bars.size() == fresh.bars.size() && panned.cpu_points.size() == fresh.cpu_points.size());
+		for (size_t i = 0; i < panned.bars.size(); i++)
+			assert(panned.bars[i].x_offset == fresh.bars[i].x_offset && panned.bars[i].value == fresh.bars[i].value);
+		for (size_t i = 0; i < panned.cpu_points.size(); i++)
+			assert(panned.cpu_points[i].x_offset == fresh.cpu_points[i].x_offset && panned.cpu_points[i].value == fresh.cpu_points[i].value);
+		assert(panned.nb_executions == fresh.nb_executions && panned.total_execution_time == fresh.total_execution_time);
+		assert(panned.maximum_duration == fresh.maximum_duration && panned.total_write_bytes == fresh.total_write_bytes);
+	}
+
+	// Executions merged in the middle of the cache invalidate it from there
+	uint64_t start_time = UnixSecondsToWindowsTick(base + 50);
+
+	group.merged_executions.insert(group.merged_executions.begin() + 1, { start_time, start_time + 20 * WINDOWS_TICK });
+	invalidate_view_cache(group.id, start_time);
+	assert(generate_view_data(&group, (double)base, (double)base + width, requested_view_generation, panned));
+	view_cache = View_Cache();
+	assert(generate_view_data(&group, (double)base, (double)base + width, requested_view_generation, fresh));
+	assert(panned.bars.size() == fresh.bars.size() && panned.nb_executions == fresh.nb_executions);
+
+	view_cache = View_Cache();
+}
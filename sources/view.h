@@ -0,0 +1,74 @@
+#pragma once
+
+#include "capture_lag.h"
+#include "time.h"
+
+#include <vector>
+
+#include <cstdint>
+
+// Point of the graph (bar, CPU time or concurrency step), the date is an offset from View_Frame::base_time
+// so a float keeps a precision of a second over months
+struct View_Point
+{
+	float	x_offset; // Seconds
+	float	value;
+};
+
+// Data of the graph and of the stats panel for a group and a visible range.
+// Frames are prepared by the view thread, which also merges recorded executions of all groups, so the
+// render thread never merges nor scans executions and keeps drawing while a heavy update is running.
+struct View_Frame
+{
+	uint32_t	group_id = 0xffffffff; // No group
+	double		range_start = 0.0; // Unix seconds
+	double		range_end = 0.0;
+
+	double					base_time = 0.0; // Unix seconds, start of the first visible bar period
+	std::vector<View_Point>	bars; // Durations of merged executions per bar period
+	double					bar_width = 1.0;
+	Time_Unit			duration_unit = Time_Unit::seconds;
+
+	uint64_t	plot_range_duration = 0;
+	uint64_t	nb_executions = 0;
+	uint64_t	total_execution_time = 0;
+	uint64_t	maximum_duration = 0;
+	double		average_executions_time = 0.0;
+
+	std::vector<View_Point>	cpu_points; // CPU times (user + kernel) per bar period, in duration_unit
+	uint64_t				total_user_time_ms = 0;
+	uint64_t				total_kernel_time_ms = 0;
+	uint64_t				total_read_bytes = 0;
+	uint64_t				total_write_bytes = 0;
+	uint32_t				peak_memory_kb = 0;
+
+	std::vector<View_Point>	concurrency_steps; // Number of running executions
+	uint32_t				maximum_concurrency = 0;
+	std::vector<uint64_t>	exclusive_times; // Per executable, Windows ticks
+
+	// Cost of the frame on the view thread
+	uint64_t	merge_duration_ns = 0; // Of pending executions of all groups
+	uint64_t	generation_duration_ns = 0;
+
+	std::vector<Execution_Capture>	captures; // Executions of the group shown for the first time by this frame
+};
+
+bool initialize_view_thread();
+void terminate_view_thread();
+
+// Range shown by the graph, a new frame is prepared when it changes (render thread)
+void request_view(uint32_t group_id, double start, double end);
+
+// Executions were recorded, they are merged and the frame is updated if needed (any thread)
+void request_view_update();
+
+// Latest prepared frame, stay valid until the next call (render thread)
+// The first call that returns a frame records the display of its captures (see capture_lag.h)
+const View_Frame& get_view_frame();
+
+// Background mode: frames aren't prepared anymore and the buffers of the frames and of the cache are
+// released, executions are still merged. Return once released, after the merge in progress (render thread)
+void suspend_view();
+void resume_view();
+
+void test_view_cache();
@@ -168,6 +168,11 @@ bool initialize_wmi_events_sink()
     return true;
 }
 
+void attach_running_processes(const Group* only_group)
+{
+    pSink->attach_running_processes(only_group);
+}
+
 void terminate_wmi_event_sink()
 {
     HRESULT hres;
@@ -1,4 +1,20 @@
 #pragma once
 
+#include <cstddef>
+
+struct Group;
+
 bool initialize_wmi_events_sink();
 void terminate_wmi_event_sink();
+
+// Track processes already running that match groups (only_group if not null) with their real start time
+void attach_running_processes(const Group* only_group = nullptr);
+
+struct Tracking_Pool_Stats
+{
+    size_t nb_tracked_processes; // Running processes waited for
+    size_t peak_nb_tracked_processes;
+    size_t capacity; // Tracking records allocated by the pool
+};
+
+Tracking_Pool_Stats get_tracking_pool_stats();